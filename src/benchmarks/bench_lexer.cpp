@@ -0,0 +1,278 @@
+// bench_lexer.cpp
+
+// Lexer throughput over synthetic Zen programs. Build with optimizations, e.g.
+//   g++ -std=c++17 -O2 -pthread src/benchmarks/bench_lexer.cpp src/code_handling/*.cpp -o bench_lexer
+//
+// Options:
+//   --size <MB>        Size of each corpus (default 8)
+//   --repeat <n>       Least runs per measurement, the fastest is reported (default 5).
+//                      Fast benchmarks get more, so each one runs for at least 0.2s.
+//   --filter <text>    Only run benchmarks whose name contains text
+//   --save <file>      Write each benchmark's MB/s to file, as a baseline
+//   --baseline <file>  Exit with 1 if any benchmark is slower than its MB/s
+//                      in file (from --save) by more than the tolerance, or if
+//                      one in file that the filter matches didn't run, for CI
+//   --tolerance <x>    Fraction slower than the baseline that still passes (default 0.2)
+//
+// An option without a value exits with 2, the same as an unknown one.
+//
+// Only lexing is timed, the lexer and its copy of the corpus are set up first.
+
+#include "../code_handling/lexer.h"
+#include "../code_handling/streaming_lexer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+struct Corpus {
+  std::string name;
+  std::string source;
+};
+
+// Lexes the prepared source and returns the number of tokens lexed
+using Run = std::function<size_t()>;
+
+struct Mode {
+  std::string name;
+  std::function<Run(const std::string&)> prepare; // Untimed setup for one run
+};
+
+std::string identifierName(std::mt19937& rng) {
+  static const char* parts[] = {"count", "total", "my_var", "index", "value", "node", "left", "right", "buffer", "item"};
+  std::string name = parts[rng() % 10];
+  if (rng() % 2) name += "_" + std::to_string(rng() % 1000);
+  return name;
+}
+
+// Declarations and calls, almost every token is a name
+std::string identifierHeavy(size_t size, std::mt19937& rng) {
+  std::string source;
+  while (source.size() < size) {
+    source += "int " + identifierName(rng) + " = " + identifierName(rng) + "(" + identifierName(rng) + ", " + identifierName(rng) + ")\n";
+  }
+  return source;
+}
+
+// Long arithmetic and comparison expressions
+std::string operatorHeavy(size_t size, std::mt19937& rng) {
+  static const char* operators[] = {"+", "-", "*", "/", "==", "!=", ">=", "<=", "<<", ">>", "+=", "&", "|", "^"};
+  std::string source;
+  while (source.size() < size) {
+    source += "x";
+    for (int i = 0; i < 16; i++) source += std::string(" ") + operators[rng() % 14] + " " + std::to_string(rng() % 100);
+    source += "\n";
+  }
+  return source;
+}
+
+std::string longStrings(size_t size, std::mt19937& rng) {
+  std::string source;
+  while (source.size() < size) {
+    source += "string greeting = \"";
+    size_t length = 256 + rng() % 4096;
+    for (size_t i = 0; i < length; i++) source += i % 7 ? static_cast<char>('a' + rng() % 26) : ' ';
+    source += "\"\n";
+  }
+  return source;
+}
+
+// Docstrings in the /. ./ style from planning/syntax.md, plus line comments
+std::string longComments(size_t size, std::mt19937& rng) {
+  std::string source;
+  while (source.size() < size) {
+    source += "/.\n";
+    for (size_t line = 0, lines = 8 + rng() % 32; line < lines; line++) {
+      source += " . this function does something with " + identifierName(rng) + " and returns it.\n";
+    }
+    source += " ./\n";
+    source += "fn " + identifierName(rng) + "(int x) -> int { // returns x\n    return x\n}\n";
+  }
+  return source;
+}
+
+std::string deepNesting(size_t size, std::mt19937& rng) {
+  std::string source;
+  while (source.size() < size) {
+    size_t depth = 16 + rng() % 48;
+    source += "fn nested(int x) {\n";
+    for (size_t i = 1; i <= depth; i++) {
+      source += std::string(i * 4, ' ') + "if (x > " + std::to_string(i) + ") {\n";
+    }
+    source += std::string((depth + 1) * 4, ' ') + "print(x)\n";
+    for (size_t i = depth; i >= 1; i--) source += std::string(i * 4, ' ') + "}\n";
+    source += "}\n";
+  }
+  return source;
+}
+
+// A bit of everything, like a typical program
+std::string mixed(size_t size, std::mt19937& rng) {
+  std::string source;
+  while (source.size() < size) {
+    switch (rng() % 5) {
+      case 0: source += identifierHeavy(256, rng); break;
+      case 1: source += operatorHeavy(256, rng); break;
+      case 2: source += "string message = \"hello from the mixed corpus\"\n"; break;
+      case 3: source += "// a line comment about " + identifierName(rng) + "\n"; break;
+      case 4: source += deepNesting(256, rng); break;
+    }
+  }
+  return source;
+}
+
+Run lexNextToken(const std::string& source) {
+  auto lexer = std::make_shared<Lexer>(source);
+  return [lexer]() {
+    size_t count = 0;
+    while (lexer->nextToken().type != TokenType::EndOfFile) count++;
+    return count;
+  };
+}
+
+Run lexTokenizeAll(const std::string& source) {
+  auto lexer = std::make_shared<Lexer>(source);
+  return [lexer]() {return lexer->tokenizeAll().size() - 1;};
+}
+
+Run lexTokenizeParallel(const std::string& source) {
+  auto lexer = std::make_shared<Lexer>(source);
+  return [lexer]() {return lexer->tokenizeParallel().size() - 1;};
+}
+
+Run lexStreaming(const std::string& source) {
+  // Reads straight out of the corpus, so the lexer's only copy is its own window
+  auto read = std::make_shared<size_t>(0);
+  auto lexer = std::make_shared<StreamingLexer>([&source, read](char* out, size_t capacity) {
+    size_t count = std::min(capacity, source.size() - *read);
+    std::memcpy(out, source.data() + *read, count);
+    *read += count;
+    return count;
+  });
+  return [lexer]() {
+    size_t count = 0;
+    while (lexer->nextToken().type != TokenType::EndOfFile) count++;
+    return count;
+  };
+}
+
+Run lexInterned(const std::string& source) {
+  auto symbols = std::make_shared<SymbolTable>();
+  auto lexer = std::make_shared<Lexer>(source);
+  lexer->useSymbolTable(*symbols);
+  return [symbols, lexer]() {return lexer->tokenizeAll().size() - 1;};
+}
+
+constexpr double MIN_SECONDS = 0.2;
+constexpr size_t MAX_RUNS = 200;
+
+// Lines of "name MB/s", as written by --save
+std::map<std::string, double> readBaseline(const std::string& path) {
+  std::ifstream file(path);
+  if (!file) throw std::runtime_error("Couldn't open " + path);
+  std::map<std::string, double> baseline;
+  std::string name;
+  double mbps;
+  while (file >> name >> mbps) baseline[name] = mbps;
+  return baseline;
+}
+
+int main(int argc, char** argv) {
+  size_t sizeMB = 8, repeat = 5;
+  double tolerance = 0.2;
+  std::string filter, savePath, baselinePath;
+  for (int i = 1; i < argc; i += 2) {
+    std::string option = argv[i];
+    if (i + 1 == argc) {
+      // Dropping it would quietly turn off a --baseline gate
+      std::cerr << "Missing value for option " << option << "\n";
+      return 2;
+    }
+    if (option == "--size") sizeMB = std::strtoul(argv[i + 1], nullptr, 10);
+    else if (option == "--repeat") repeat = std::max<size_t>(1, std::strtoul(argv[i + 1], nullptr, 10));
+    else if (option == "--filter") filter = argv[i + 1];
+    else if (option == "--save") savePath = argv[i + 1];
+    else if (option == "--baseline") baselinePath = argv[i + 1];
+    else if (option == "--tolerance") tolerance = std::strtod(argv[i + 1], nullptr);
+    else {
+      std::cerr << "Unknown option " << option << "\n";
+      return 2;
+    }
+  }
+
+  std::map<std::string, double> baseline;
+  if (!baselinePath.empty()) baseline = readBaseline(baselinePath);
+  std::ofstream save;
+  if (!savePath.empty()) save.open(savePath);
+
+  std::mt19937 rng(42); // Fixed seed so runs are comparable
+  size_t size = sizeMB * 1024 * 1024;
+  std::vector<Corpus> corpora = {
+    {"identifiers", identifierHeavy(size, rng)},
+    {"operators", operatorHeavy(size, rng)},
+    {"strings", longStrings(size, rng)},
+    {"comments", longComments(size, rng)},
+    {"nesting", deepNesting(size, rng)},
+    {"mixed", mixed(size, rng)},
+  };
+  std::vector<Mode> modes = {
+    {"nextToken", lexNextToken},
+    {"tokenizeAll", lexTokenizeAll},
+    {"tokenizeParallel", lexTokenizeParallel},
+    {"streaming", lexStreaming},
+    {"interned", lexInterned},
+  };
+
+  bool failed = false;
+  std::set<std::string> ran;
+  std::cout << std::left << std::setw(36) << "benchmark" << std::right << std::setw(12) << "MB/s" << std::setw(12) << "Mtok/s" << "\n";
+  for (const Corpus& corpus : corpora) {
+    for (const Mode& mode : modes) {
+      std::string name = corpus.name + "/" + mode.name;
+      if (name.find(filter) == std::string::npos) continue;
+      ran.insert(name);
+
+      double best = 1e100, total = 0;
+      size_t tokens = 0;
+      for (size_t run = 0; run < repeat || (total < MIN_SECONDS && run < MAX_RUNS); run++) {
+        Run lex = mode.prepare(corpus.source);
+        auto start = std::chrono::steady_clock::now();
+        tokens = lex();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+        total += elapsed.count();
+      }
+
+      double mbps = corpus.source.size() / best / (1024 * 1024);
+      double mtps = tokens / best / 1e6;
+      auto expected = baseline.find(name);
+      bool slow = expected != baseline.end() && mbps < expected->second * (1 - tolerance);
+      failed = failed || slow;
+      if (save) save << name << " " << mbps << "\n";
+      std::cout << std::left << std::setw(36) << name << std::right << std::fixed << std::setprecision(1)
+                << std::setw(12) << mbps << std::setw(12) << mtps;
+      if (slow) std::cout << "  slower than baseline " << expected->second;
+      std::cout << "\n";
+    }
+  }
+
+  // A renamed or removed benchmark would otherwise drop out of the gate unnoticed
+  for (const auto& [name, mbps] : baseline) {
+    if (name.find(filter) == std::string::npos || ran.count(name)) continue;
+    std::cout << name << " is in the baseline but didn't run\n";
+    failed = true;
+  }
+
+  return failed ? 1 : 0;
+}
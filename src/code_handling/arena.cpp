@@ -0,0 +1,92 @@
+// arena.cpp
+
+#include "arena.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+namespace {
+
+size_t paddingFor(const std::byte* pointer, size_t alignment) {
+  return static_cast<size_t>(-reinterpret_cast<uintptr_t>(pointer)) & (alignment - 1);
+}
+
+} // namespace
+
+Arena::Arena(Arena&& other) noexcept
+    : blockSize(other.blockSize), blocks(std::exchange(other.blocks, {})), blockIndex(std::exchange(other.blockIndex, 0)),
+      next(std::exchange(other.next, nullptr)), end(std::exchange(other.end, nullptr)), used(std::exchange(other.used, 0)) {}
+
+Arena& Arena::operator=(Arena&& other) noexcept {
+  if (this != &other) {
+    blockSize = other.blockSize;
+    blocks = std::exchange(other.blocks, {});
+    blockIndex = std::exchange(other.blockIndex, 0);
+    next = std::exchange(other.next, nullptr);
+    end = std::exchange(other.end, nullptr);
+    used = std::exchange(other.used, 0);
+  }
+  return *this;
+}
+
+void* Arena::allocate(size_t size, size_t alignment) {
+  size_t padding = paddingFor(next, alignment);
+  if (next == nullptr || static_cast<size_t>(end - next) < size + padding) return allocateSlow(size, alignment);
+
+  std::byte* allocation = next + padding;
+  next = allocation + size;
+  used += padding + size;
+  return allocation;
+}
+
+void* Arena::allocateSlow(size_t size, size_t alignment) {
+  // Move on to the next block that's big enough, reusing blocks kept by reset
+  size_t needed = size + alignment - 1;
+  size_t first = blocks.empty() ? 0 : blockIndex + 1;
+  size_t index = first;
+  while (index < blocks.size() && blocks[index].size < needed) index++;
+
+  if (index == blocks.size()) {
+    // Allocations bigger than a block get a block to themselves
+    // new without () so the block isn't zeroed, everything put in it gets constructed anyway
+    size_t newSize = std::max(blockSize, needed);
+    blocks.push_back({std::unique_ptr<std::byte[]>(new std::byte[newSize]), newSize});
+  }
+  if (index != first) {
+    // Keep the blocks that were too small after this one, so they still get used
+    std::rotate(blocks.begin() + first, blocks.begin() + index, blocks.begin() + index + 1);
+    index = first;
+  }
+
+  blockIndex = index;
+  next = blocks[index].data.get();
+  end = next + blocks[index].size;
+
+  size_t padding = paddingFor(next, alignment);
+  std::byte* allocation = next + padding;
+  next = allocation + size;
+  used += padding + size;
+  return allocation;
+}
+
+std::string_view Arena::copy(std::string_view text) {
+  if (text.empty()) return std::string_view();
+  char* stored = static_cast<char*>(allocate(text.length(), 1));
+  std::memcpy(stored, text.data(), text.length());
+  return std::string_view(stored, text.length());
+}
+
+void Arena::reset() {
+  blockIndex = 0;
+  next = blocks.empty() ? nullptr : blocks[0].data.get();
+  end = blocks.empty() ? nullptr : next + blocks[0].size;
+  used = 0;
+}
+
+size_t Arena::bytesReserved() const {
+  size_t total = 0;
+  for (const Block& block : blocks) total += block.size;
+  return total;
+}
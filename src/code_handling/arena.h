@@ -0,0 +1,72 @@
+// arena.h
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator for data that all dies at once, like the AST of a module.
+// Allocating is a pointer bump, nothing is freed on its own and destructors
+// are never run, so only trivially destructible types can live in it. reset()
+// frees everything in one go but keeps the blocks, so the next compilation
+// reuses the memory instead of asking the heap for it again.
+class Arena {
+public:
+  static constexpr size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+  explicit Arena(size_t blockSize = DEFAULT_BLOCK_SIZE) : blockSize(blockSize) {}
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+  // The moved from arena is left empty, it doesn't keep bumping through blocks it gave away
+  Arena(Arena&& other) noexcept;
+  Arena& operator=(Arena&& other) noexcept;
+
+  void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+  template <typename T, typename... Args>
+  T* make(Args&&... args) {
+    static_assert(std::is_trivially_destructible_v<T>, "Arena never runs destructors");
+    return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+  }
+
+  // Room for count value-initialised Ts
+  template <typename T>
+  T* makeArray(size_t count) {
+    static_assert(std::is_trivially_destructible_v<T>, "Arena never runs destructors");
+    T* array = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    for (size_t i = 0; i < count; i++) new (array + i) T();
+    return array;
+  }
+
+  // Copy of text that lives as long as the arena's contents do
+  std::string_view copy(std::string_view text);
+
+  // Free everything allocated so far. Pointers into the arena are left dangling.
+  void reset();
+
+  size_t bytesUsed() const {return used;}   // Includes alignment padding
+  size_t bytesReserved() const;              // Total size of the blocks held
+
+private:
+  struct Block {
+    std::unique_ptr<std::byte[]> data;
+    size_t size;
+  };
+
+  size_t blockSize;
+  std::vector<Block> blocks;
+  size_t blockIndex = 0; // Block being bumped through
+  std::byte* next = nullptr;
+  std::byte* end = nullptr;
+  size_t used = 0;
+
+  void* allocateSlow(size_t size, size_t alignment);
+};
+
+#endif // ARENA_H
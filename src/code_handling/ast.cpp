@@ -0,0 +1,93 @@
+// ast.cpp
+
+#include "ast.h"
+
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+std::string_view astKindName(AstKind kind) {
+  switch (kind) {
+    case AstKind::Module: return "Module";
+    case AstKind::Block: return "Block";
+    case AstKind::VariableDecl: return "VariableDecl";
+    case AstKind::FunctionDecl: return "FunctionDecl";
+    case AstKind::Parameter: return "Parameter";
+    case AstKind::Lambda: return "Lambda";
+    case AstKind::ClassDecl: return "ClassDecl";
+    case AstKind::Constructor: return "Constructor";
+    case AstKind::Decorator: return "Decorator";
+    case AstKind::If: return "If";
+    case AstKind::ElseIf: return "ElseIf";
+    case AstKind::Else: return "Else";
+    case AstKind::For: return "For";
+    case AstKind::While: return "While";
+    case AstKind::Return: return "Return";
+    case AstKind::TypeName: return "TypeName";
+    case AstKind::Name: return "Name";
+    case AstKind::NumberLiteral: return "NumberLiteral";
+    case AstKind::StringLiteral: return "StringLiteral";
+    case AstKind::NullLiteral: return "NullLiteral";
+    case AstKind::ArrayLiteral: return "ArrayLiteral";
+    case AstKind::MapLiteral: return "MapLiteral";
+    case AstKind::MapEntry: return "MapEntry";
+    case AstKind::SetLiteral: return "SetLiteral";
+    case AstKind::TupleLiteral: return "TupleLiteral";
+    case AstKind::Call: return "Call";
+    case AstKind::Index: return "Index";
+    case AstKind::Member: return "Member";
+    case AstKind::Unary: return "Unary";
+    case AstKind::Binary: return "Binary";
+    case AstKind::Assign: return "Assign";
+  }
+  return "Unknown";
+}
+
+Ast::Ast(Ast&& other) noexcept
+    : nodeArena(std::move(other.nodeArena)), blocks(std::exchange(other.blocks, {})), count(std::exchange(other.count, 0)) {}
+
+Ast& Ast::operator=(Ast&& other) noexcept {
+  if (this != &other) {
+    nodeArena = std::move(other.nodeArena);
+    blocks = std::exchange(other.blocks, {});
+    count = std::exchange(other.count, 0);
+  }
+  return *this;
+}
+
+NodeIndex Ast::add(AstKind kind, uint32_t token, NodeList children, uint8_t flags) {
+  if (count == NO_NODE) throw std::length_error("Ast node indexes are 32 bit, too many nodes");
+
+  if (count % NODES_PER_BLOCK == 0 && count / NODES_PER_BLOCK == blocks.size()) {
+    // Left uninitialised, each node is constructed when it's added
+    blocks.push_back(static_cast<AstNode*>(nodeArena.allocate(sizeof(AstNode) * NODES_PER_BLOCK, alignof(AstNode))));
+  }
+
+  NodeIndex index = count++;
+  new (&(*this)[index]) AstNode{kind, flags, token, children.first, NO_NODE};
+  return index;
+}
+
+void Ast::append(NodeList& list, NodeIndex node) {
+  if (list.last == NO_NODE) list.first = node;
+  else (*this)[list.last].nextSibling = node;
+  list.last = node;
+}
+
+size_t Ast::childCount(NodeIndex node) const {
+  size_t children = 0;
+  for (NodeIndex child = (*this)[node].firstChild; child != NO_NODE; child = (*this)[child].nextSibling) children++;
+  return children;
+}
+
+size_t Ast::bytesUsed() const {
+  // Node blocks are taken from the arena whole, leave out the nodes not added yet
+  size_t unusedNodes = blocks.size() * NODES_PER_BLOCK - count;
+  return nodeArena.bytesUsed() - unusedNodes * sizeof(AstNode);
+}
+
+void Ast::reset() {
+  nodeArena.reset();
+  blocks.clear();
+  count = 0;
+}
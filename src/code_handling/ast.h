@@ -0,0 +1,138 @@
+// ast.h
+
+#ifndef AST_H
+#define AST_H
+
+#include "arena.h"
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Nodes refer to each other by index rather than pointer, so a link is 4 bytes
+using NodeIndex = uint32_t;
+inline constexpr NodeIndex NO_NODE = UINT32_MAX;
+
+// One kind per construct in planning/syntax.md. The comments list each kind's
+// children in order, and which token the node points at.
+enum class AstKind : uint8_t {
+  Module,          // Statements, token is the first token of the module
+  Block,           // Statements, token is the {
+  VariableDecl,    // Type, then the value if there is one, token is the name
+  FunctionDecl,    // Parameters, return type if there is one, then the body, token is the name
+  Parameter,       // Type, then the default if there is one, token is the name
+  Lambda,          // Parameters, return type, then the body, token is the =>
+  ClassDecl,       // Bases, then members, token is the name
+  Constructor,     // Parameters, then the body, token is constructor
+  Decorator,       // Arguments, token is the name after @
+  If,              // Condition, body, then an ElseIf or Else if there is one, token is if
+  ElseIf,          // Condition, body, then an ElseIf or Else if there is one, token is elseif
+  Else,            // Body, token is else
+  For,             // Loop variables, iterable, then the body, token is for
+  While,           // Condition, then the body, token is while
+  Return,          // Value if there is one, token is return
+  TypeName,        // Type arguments, as in array[int], token is the type
+  Name,            // Token is the identifier
+  NumberLiteral,   // Token is the number
+  StringLiteral,   // Token is the string
+  NullLiteral,     // Token is null
+  ArrayLiteral,    // Elements, token is the [
+  MapLiteral,      // MapEntry children, token is the [
+  MapEntry,        // Key, then value, token is the :
+  SetLiteral,      // Elements, token is the {
+  TupleLiteral,    // Elements of a lockedarray, token is the (
+  Call,            // Callee, then arguments, token is the (
+  Index,           // Indexed value, then the index, token is the [
+  Member,          // Object, token is the member's name
+  Unary,           // Operand, token is the operator
+  Binary,          // Left, then right, token is the operator
+  Assign,          // Target, then value, token is the operator (=, += ...)
+};
+
+std::string_view astKindName(AstKind kind);
+
+enum AstFlag : uint8_t {
+  FLAG_PRIVATE = 1 << 0, // Class member declared private
+};
+
+// 16 bytes, so four nodes share a cache line. Nodes hold no text, token is
+// the index of the node's token in the module's TokenStream, which has its
+// kind, text and position.
+struct AstNode {
+  AstKind kind;
+  uint8_t flags;
+  uint32_t token;
+  NodeIndex firstChild;  // NO_NODE if the node has no children
+  NodeIndex nextSibling; // NO_NODE if the node is its parent's last child
+};
+static_assert(sizeof(AstNode) == 16, "AstNode should stay 16 bytes");
+
+// Children being collected for a node that hasn't been added yet. Keeping the
+// last child here instead of in every node lets appending stay O(1).
+struct NodeList {
+  NodeIndex first = NO_NODE;
+  NodeIndex last = NO_NODE;
+};
+
+// The tree of one module. Nodes are allocated from the tree's arena in fixed
+// size blocks, in the order the parser creates them, so walking the tree
+// mostly moves forward through memory. reset() throws the whole tree away at
+// once and keeps the memory for the next module.
+class Ast {
+public:
+  class ChildIterator {
+  public:
+    ChildIterator(const Ast& ast, NodeIndex node) : ast(&ast), node(node) {}
+    NodeIndex operator*() const {return node;}
+    ChildIterator& operator++() {node = (*ast)[node].nextSibling; return *this;}
+    bool operator!=(const ChildIterator& other) const {return node != other.node;}
+
+  private:
+    const Ast* ast;
+    NodeIndex node;
+  };
+
+  struct ChildRange {
+    ChildIterator first, last;
+    ChildIterator begin() const {return first;}
+    ChildIterator end() const {return last;}
+  };
+
+  Ast() = default;
+  Ast(const Ast&) = delete;
+  Ast& operator=(const Ast&) = delete;
+  // The moved from tree is left empty and can be reused
+  Ast(Ast&& other) noexcept;
+  Ast& operator=(Ast&& other) noexcept;
+
+  // Add a node, taking ownership of children. They must not be in any other list.
+  NodeIndex add(AstKind kind, uint32_t token, NodeList children = {}, uint8_t flags = 0);
+  // Add node to the end of list
+  void append(NodeList& list, NodeIndex node);
+
+  AstNode& operator[](NodeIndex index) {return blocks[index / NODES_PER_BLOCK][index % NODES_PER_BLOCK];}
+  const AstNode& operator[](NodeIndex index) const {return blocks[index / NODES_PER_BLOCK][index % NODES_PER_BLOCK];}
+
+  // Walk a node's children with for (NodeIndex child : ast.children(node))
+  ChildRange children(NodeIndex node) const {return {{*this, (*this)[node].firstChild}, {*this, NO_NODE}};}
+  size_t childCount(NodeIndex node) const;
+
+  size_t size() const {return count;}
+  // Arena bytes used by the nodes added so far and anything else put in arena()
+  size_t bytesUsed() const;
+  // Free every node at once. Indexes from before are no longer valid.
+  void reset();
+
+  // Per-module memory for anything else that should be freed with the tree
+  Arena& arena() {return nodeArena;}
+  const Arena& arena() const {return nodeArena;}
+
+private:
+  static constexpr size_t NODES_PER_BLOCK = 4096; // 64 KiB per block
+
+  Arena nodeArena{NODES_PER_BLOCK * sizeof(AstNode) + alignof(AstNode)};
+  std::vector<AstNode*> blocks; // Blocks never move, so references to nodes stay valid as the tree grows
+  NodeIndex count = 0;
+};
+
+#endif // AST_H
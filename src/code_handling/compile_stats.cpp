@@ -0,0 +1,56 @@
+// compile_stats.cpp
+
+#include "compile_stats.h"
+
+#include "ast.h"
+
+std::string_view compilePhaseName(CompilePhase phase) {
+  switch (phase) {
+    case CompilePhase::Lex: return "lex";
+    case CompilePhase::Parse: return "parse";
+    case CompilePhase::Optimize: return "optimize";
+    case CompilePhase::CodeGen: return "codegen";
+  }
+  return "unknown";
+}
+
+void CompileStats::addTime(CompilePhase phase, uint64_t nanoseconds) {
+  phaseNanoseconds[static_cast<size_t>(phase)] += nanoseconds;
+  phaseRuns[static_cast<size_t>(phase)]++;
+}
+
+void CompileStats::countAst(const Ast& ast) {
+  astNodes += ast.size();
+  arenaBytes += ast.bytesUsed();
+}
+
+void CompileStats::merge(const CompileStats& other) {
+  tokens += other.tokens;
+  bytesLexed += other.bytesLexed;
+  astNodes += other.astNodes;
+  arenaBytes += other.arenaBytes;
+  for (size_t phase = 0; phase < COMPILE_PHASE_COUNT; phase++) {
+    phaseNanoseconds[phase] += other.phaseNanoseconds[phase];
+    phaseRuns[phase] += other.phaseRuns[phase];
+  }
+}
+
+std::string CompileStats::toJson() const {
+  std::string json = "{\"tokens\": " + std::to_string(tokens)
+      + ", \"bytes_lexed\": " + std::to_string(bytesLexed)
+      + ", \"ast_nodes\": " + std::to_string(astNodes)
+      + ", \"arena_bytes\": " + std::to_string(arenaBytes)
+      + ", \"phases\": {";
+  for (size_t phase = 0; phase < COMPILE_PHASE_COUNT; phase++) {
+    if (phase > 0) json += ", ";
+    json += "\"" + std::string(compilePhaseName(static_cast<CompilePhase>(phase))) + "\": {\"ns\": "
+        + std::to_string(phaseNanoseconds[phase]) + ", \"runs\": " + std::to_string(phaseRuns[phase]) + "}";
+  }
+  return json + "}}";
+}
+
+PhaseTimer::~PhaseTimer() {
+  if (!stats) return;
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  stats->addTime(phase, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
@@ -0,0 +1,65 @@
+// compile_stats.h
+
+#ifndef COMPILE_STATS_H
+#define COMPILE_STATS_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+class Ast;
+
+enum class CompilePhase : uint8_t {
+  Lex,
+  Parse,
+  Optimize,
+  CodeGen,
+};
+inline constexpr size_t COMPILE_PHASE_COUNT = 4;
+
+std::string_view compilePhaseName(CompilePhase phase);
+
+// What the front end did and how long it took, for one file or summed over
+// many. Stages add to it when given one (see Lexer::useStats), and it's plain
+// counters so a stats object shouldn't be shared between threads. Give each
+// thread its own and merge them.
+struct CompileStats {
+  uint64_t tokens = 0;     // Tokens lexed, not counting EndOfFile
+  uint64_t bytesLexed = 0; // Source bytes the lexer went through, a relex only counts what it lexed again
+  uint64_t astNodes = 0;
+  uint64_t arenaBytes = 0; // Arena bytes used by ASTs, including alignment padding
+  uint64_t phaseNanoseconds[COMPILE_PHASE_COUNT] = {};
+  uint64_t phaseRuns[COMPILE_PHASE_COUNT] = {};
+
+  uint64_t nanoseconds(CompilePhase phase) const {return phaseNanoseconds[static_cast<size_t>(phase)];}
+  uint64_t runs(CompilePhase phase) const {return phaseRuns[static_cast<size_t>(phase)];}
+
+  void addTime(CompilePhase phase, uint64_t nanoseconds);
+  // Count the nodes and arena bytes of a finished tree
+  void countAst(const Ast& ast);
+  void merge(const CompileStats& other);
+  void reset() {*this = CompileStats();}
+
+  // {"tokens": 12, "bytes_lexed": 40, ..., "phases": {"lex": {"ns": 1500, "runs": 1}, ...}}
+  std::string toJson() const;
+};
+
+// Adds the time from its construction to its destruction to a phase. Does
+// nothing if stats is null, so stages can time themselves unconditionally.
+class PhaseTimer {
+public:
+  PhaseTimer(CompileStats* stats, CompilePhase phase)
+      : stats(stats), phase(phase), start(stats ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point()) {}
+  PhaseTimer(const PhaseTimer&) = delete;
+  PhaseTimer& operator=(const PhaseTimer&) = delete;
+  ~PhaseTimer();
+
+private:
+  CompileStats* stats;
+  CompilePhase phase;
+  std::chrono::steady_clock::time_point start;
+};
+
+#endif // COMPILE_STATS_H
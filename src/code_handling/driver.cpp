@@ -0,0 +1,70 @@
+// driver.cpp
+
+#include "driver.h"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <numeric>
+#include <system_error>
+#include <thread>
+
+namespace {
+
+void lexModule(LexedModule& module, SharedSymbolTable& symbols) {
+  try {
+    module.lexer = std::make_unique<Lexer>(Lexer::fromFile(module.path));
+    SymbolTable local;
+    module.lexer->useSymbolTable(local);
+    module.lexer->useStats(module.stats);
+    module.tokens = module.lexer->tokenizeAll();
+
+    std::vector<SymbolId> shared(local.size());
+    for (SymbolId id = 0; id < local.size(); id++) shared[id] = symbols.intern(local.text(id));
+    for (SymbolId& symbol : module.tokens.symbols) {
+      if (symbol != NO_SYMBOL) symbol = shared[symbol];
+    }
+  } catch (...) {
+    module.error = std::current_exception();
+  }
+
+  // local is about to go, and module can be moved out of its vector, so the
+  // lexer mustn't keep pointing at either
+  if (module.lexer) {
+    module.lexer->clearSymbolTable();
+    module.lexer->clearStats();
+  }
+}
+
+} // namespace
+
+std::vector<LexedModule> lexModules(const std::vector<std::string>& paths, SharedSymbolTable& symbols, size_t threadCount) {
+  std::vector<LexedModule> modules(paths.size());
+  std::vector<uintmax_t> sizes(paths.size());
+  for (size_t i = 0; i < paths.size(); i++) {
+    modules[i].path = paths[i];
+    std::error_code error;
+    sizes[i] = std::filesystem::file_size(paths[i], error);
+    if (error) sizes[i] = 0; // Lexing it reports the problem
+  }
+
+  std::vector<size_t> order(paths.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {return sizes[a] > sizes[b];});
+
+  // Files are independent, so a shared counter is all the scheduling needed.
+  // Each thread takes the next file as soon as it's done with its last one.
+  std::atomic<size_t> next{0};
+  auto work = [&]() {
+    for (size_t i = next++; i < order.size(); i = next++) lexModule(modules[order[i]], symbols);
+  };
+
+  if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+  threadCount = std::min(threadCount, paths.size());
+  std::vector<std::thread> workers;
+  for (size_t thread = 1; thread < threadCount; thread++) workers.emplace_back(work);
+  work();
+  for (std::thread& worker : workers) worker.join();
+
+  return modules;
+}
@@ -0,0 +1,32 @@
+// driver.h
+
+#ifndef DRIVER_H
+#define DRIVER_H
+
+#include "compile_stats.h"
+#include "lexer.h"
+#include "symbol_table.h"
+
+#include <exception>
+#include <memory>
+#include <string>
+#include <vector>
+
+// One file's share of a multi-file compilation
+struct LexedModule {
+  std::string path;
+  std::unique_ptr<Lexer> lexer; // Owns the source that tokens views into, has no symbol table or stats attached
+  TokenStream tokens;           // tokens.symbols are ids in the shared table
+  CompileStats stats;
+  std::exception_ptr error;     // Set if the file couldn't be read or lexed, the other files still are
+};
+
+// Lex every file concurrently on threadCount threads (0 for one per core),
+// interning into one table shared by them all. Each file is interned into a
+// table of its own while it's lexed and only its unique texts go into the
+// shared table afterwards, so threads rarely touch the shared table. Files
+// are handed out biggest first, so one big file left until last doesn't hold
+// everything up. Modules come back in the order of paths.
+std::vector<LexedModule> lexModules(const std::vector<std::string>& paths, SharedSymbolTable& symbols, size_t threadCount = 0);
+
+#endif // DRIVER_H
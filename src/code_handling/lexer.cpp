@@ -2,308 +2,623 @@
 
 // TODO:
 //    1. MODULARIZE
-//    2. ADD EDGE CASE PROTECTION FOR STRING PARSING (ESCAPE SEQUENCES, NO CLOSING QUOTE, ETC)
+//    2. ADD EDGE CASE PROTECTION FOR STRING PARSING (ESCAPE SEQUENCES)
+
+#include "lexer.h"
+#include "scan.h"
 
 #include <algorithm>
-#include <any>
+#include <array>
+#include <cstdint>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
 #include <vector>
 
-const char EOF_CHAR = '\0';
-const std::vector<std::string> KEYWORDS = {
-  "if",
-  "elseif",
-  "else",
-  "for",
-  "in",
-  "while",
-  "fn",
-  "class",
-  "private",
-};
-const std::vector<char> CHAR_OPERATORS = {
-  '=',
-  '+',
-  '-',
-  '*',
-  '/',
-  '>',
-  '<',
-  '@',
-  '&',
-  '|',
-  '^',
-  '!',
-  '~',
-};
-const std::vector<std::string> STRING_OPERATORS = {
-  ">=",
-  "<=",
-  "==",
-  "!=",
-  "->",
-  "=>",
-  "++",
-  "--",
-  "+=",
-  "-=",
-  "*=",
-  "/=",
-  "<<",
-  ">>",
-};
-const std::vector<std::string> TYPES = {
-  "int",
-  "float",
-  "complex",
-  "string",
-  "array",
-  "lockedarray",
-  "map",
-  "lockedmap",
-  "set",
-  "lockedset",
-  "bool",
-  "nulltype",
-}; // Add more when needed
-const std::vector<char> WHITESPACE = {
-  ' ',  // U+0020
-  '\t', // U+0009
-  '\n', // U+000A
-  '\r', // U+000D
-  '\v', // U+000B
-  '\f', // U+000C
-};
+namespace {
 
-enum class TokenType {
-  Identifier,
-  Keyword,
-  Number,
-  String,
-  Operator,
-  Comment,
-  MultilineComment, // We track multiline comments separately since they're used for docstrings
-  OpenParen,
-  CloseParen,
-  OpenBracket,
-  CloseBracket,
-  OpenBrace,
-  CloseBrace,
-  Comma,
-  EndOfFile,
-  Null,
-  Type,
+// Character classes, one bit each so a single table load answers any of them
+enum CharClass : uint8_t {
+  CLASS_WHITESPACE = 1 << 0,
+  CLASS_OPERATOR = 1 << 1,
+  CLASS_IDENTIFIER_START = 1 << 2,
+  CLASS_IDENTIFIER = 1 << 3,
+  CLASS_DIGIT = 1 << 4,
+  CLASS_PUNCTUATION = 1 << 5, // Quotes, brackets and commas
 };
 
-struct Token {
-  TokenType type;
-  std::string value;
-  size_t line;
-  size_t column;
+constexpr std::array<uint8_t, 256> buildCharClasses() {
+  std::array<uint8_t, 256> classes{};
+  for (char ch : WHITESPACE) classes[static_cast<unsigned char>(ch)] |= CLASS_WHITESPACE;
+  for (char ch : CHAR_OPERATORS) classes[static_cast<unsigned char>(ch)] |= CLASS_OPERATOR;
+  for (int ch = 'a'; ch <= 'z'; ch++) classes[ch] |= CLASS_IDENTIFIER_START | CLASS_IDENTIFIER;
+  for (int ch = 'A'; ch <= 'Z'; ch++) classes[ch] |= CLASS_IDENTIFIER_START | CLASS_IDENTIFIER;
+  for (int ch = '0'; ch <= '9'; ch++) classes[ch] |= CLASS_IDENTIFIER | CLASS_DIGIT;
+  classes['_'] |= CLASS_IDENTIFIER_START | CLASS_IDENTIFIER;
+  for (char ch : {'\'', '"', '(', ')', '[', ']', '{', '}', ','}) classes[static_cast<unsigned char>(ch)] |= CLASS_PUNCTUATION;
+  return classes;
+}
 
-  Token(TokenType type, const std::string& value, size_t line, size_t column) : type(type), value(value), line(line), column(column) {}
-};
+constexpr std::array<uint8_t, 256> CHAR_CLASSES = buildCharClasses();
 
-class InvalidTokenError : public std::exception {
-  private:
-    std::string message, source;
-    size_t current, line, column;
-
-  public:
-    InvalidTokenError(std::string src, size_t pos, size_t lineno, size_t colno)
-    : source(src), current(pos), line(lineno), column(colno) {
-      int bkBuff = 5, fwdBuff = 50;
-      message = "InvalidTokenError thrown at line " + std::to_string(line) + ", column " + std::to_string(column) + " in src:\n...";
-      for (size_t i = current - bkBuff; i < source.length() && i < current + fwdBuff; i++) {
-        message += source[i];
-      }
-    }
+bool hasClass(char ch, uint8_t charClass) {
+  return CHAR_CLASSES[static_cast<unsigned char>(ch)] & charClass;
+}
 
-    const char* what() const noexcept override {
-      return message.c_str();
-    }
+// Perfect hash over words, keyed on the length and the first and last chars.
+// Every word in a table must land in its own slot, which is checked at compile
+// time; if adding a word trips the static_assert, tweak the multipliers.
+constexpr size_t WORD_TABLE_SIZE = 64;
+
+constexpr size_t wordHash(std::string_view word) {
+  return (word.size() * 10 + static_cast<unsigned char>(word.front()) * 6 + static_cast<unsigned char>(word.back())) & (WORD_TABLE_SIZE - 1);
+}
+
+struct WordTable {
+  std::array<std::string_view, WORD_TABLE_SIZE> words{};
+  std::array<TokenType, WORD_TABLE_SIZE> types{};
+  bool collision = false;
+
+  constexpr void add(std::string_view word, TokenType type) {
+    size_t slot = wordHash(word);
+    if (!words[slot].empty()) collision = true;
+    words[slot] = word;
+    types[slot] = type;
+  }
+
+  // Returns the type of word, or fallback if it isn't in the table
+  constexpr TokenType find(std::string_view word, TokenType fallback) const {
+    size_t slot = wordHash(word);
+    return words[slot] == word ? types[slot] : fallback;
+  }
 };
 
-class Lexer {
-public:
-  Lexer(const std::string& source)
-      : source(source), current(0), line(1), column(0) {}
+constexpr WordTable buildReservedWords() {
+  WordTable table;
+  for (std::string_view word : KEYWORDS) table.add(word, TokenType::Keyword);
+  for (std::string_view word : TYPES) table.add(word, TokenType::Type);
+  table.add("null", TokenType::Null);
+  return table;
+}
 
-  Token Lexer::nextToken() {
-    if (current != 0) advance(); // Skip to next char after returning previous token
-    if (current == EOF_CHAR) return Token(TokenType::EndOfFile, "", line, column);
+constexpr WordTable buildStringOperators() {
+  WordTable table;
+  for (std::string_view op : STRING_OPERATORS) table.add(op, TokenType::Operator);
+  return table;
+}
 
-    skipWhitespace();
+constexpr WordTable RESERVED_WORDS = buildReservedWords();
+constexpr WordTable STRING_OPERATOR_TABLE = buildStringOperators();
+static_assert(!RESERVED_WORDS.collision, "Reserved words collide in the perfect hash, adjust wordHash");
+static_assert(!STRING_OPERATOR_TABLE.collision, "String operators collide in the perfect hash, adjust wordHash");
 
-    // Handle end of the file
-    if (current >= source.length()) {
-        return Token(TokenType::EndOfFile, "", line, column);
-    }
+bool isIdentifier(char ch, bool first=false) {
+  return hasClass(ch, first ? CLASS_IDENTIFIER_START : CLASS_IDENTIFIER);
+}
 
-    char currentChar = peek();
+// Lexes the rest of the scanner's source onto the end of stream. Unless
+// recovering, stops at the first error and returns it, with the scanner left
+// at the bad token.
+LexError scanAll(Scanner& scanner, TokenStream& stream, bool recover) {
+  while (true) {
+    scanner.skipWhitespace();
+    if (scanner.atEnd()) return LexError::None;
+
+    size_t start = scanner.current;
+    TokenType type;
+    std::string_view value;
+    LexError error = scanner.scanToken(type, value);
+    if (error != LexError::None) {
+      if (!recover) return error;
+      stream.errors.push_back({start, error});
+      scanner.skipError(error);
+      continue;
+    }
+    stream.push(type, static_cast<uint32_t>(start), static_cast<uint32_t>(scanner.current - start));
+  }
+}
 
-    // Handle identifiers / keywords
-    if (isIdentifier(currentChar, true)) {
-      std::string identifier;
-      size_t initColumn = column;
+// Below this many bytes per thread, splitting the source costs more than it saves
+constexpr size_t MIN_PARALLEL_CHUNK = 64 * 1024;
+
+// Picks where to split source[start:] into up to parts chunks that can be lexed
+// on their own. Every split is just past a newline that isn't inside a string
+// or comment, so no token crosses it and a chunk lexes exactly the same as it
+// would as part of the whole source. Only strings and comments change what
+// counts as a token boundary, so the pre-scan just hops between quotes and
+// slashes. Returns the chunk boundaries, starting with start and ending with
+// the source length.
+std::vector<size_t> findSplitPoints(std::string_view source, size_t start, size_t parts) {
+  const char* begin = source.data();
+  const char* end = begin + source.length();
+  size_t chunkSize = (source.length() - start) / parts;
+
+  std::vector<size_t> splits{start};
+  const char* ch = begin + start;
+  for (size_t part = 1; part < parts; part++) {
+    const char* target = begin + start + part * chunkSize;
+
+    while (true) {
+      const char* special = findQuoteOrSlash(ch, end);
+
+      // Everything up to special is outside strings and comments
+      const char* newline = findChar(std::max(ch, target), std::max(special, target), '\n');
+      if (newline < special) {
+        ch = newline + 1;
+        break;
+      }
+      if (special == end) {
+        ch = end;
+        break;
+      }
 
-      while (isIdentifier(currentChar)) {
-        identifier += advance();
-        currentChar = peek();
-        if (currentChar == EOF_CHAR) return Token(TokenType::EndOfFile, "", line, column);
+      // Hop over the string or comment starting at special, the same way the scanner would
+      if (*special != '/') {
+        ch = findChar(special + 1, end, *special);
+        if (ch < end) ch++;
+      } else if (end - special >= 2 && special[1] == '/') {
+        ch = findChar(special + 2, end, '\n'); // The newline itself is outside the comment
+      } else if (end - special >= 2 && special[1] == '.') {
+        ch = findCommentEnd(special + 2, end);
+        if (ch < end) ch += 2;
+      } else {
+        ch = special + 1;
       }
-      // Handle null
-      if (identifier == "null") return Token(TokenType::Null, identifier, line, initColumn);
-      // Check if the identifier is a keyword
-      if (valueIn(identifier, KEYWORDS)) return Token(TokenType::Keyword, identifier, line, initColumn);
-      // Check if the identifier is a type
-      if (valueIn(identifier, TYPES)) return Token(TokenType::Type, identifier, line, initColumn);
-      // Otherwise, it's a user defined identifier
-      return Token(TokenType::Identifier, identifier, line, initColumn);
     }
 
-    // Handle numbers
-    if (isdigit(currentChar)) {
-      std::string number;
-      size_t initColumn = column;
+    if (ch >= end) break;
+    if (static_cast<size_t>(ch - begin) > splits.back()) splits.push_back(ch - begin);
+  }
+  splits.push_back(source.length());
+  return splits;
+}
 
-      while (isdigit(currentChar)) {
-        number += advance();
-        currentChar = peek();
-        if (currentChar == EOF_CHAR) return Token(TokenType::EndOfFile, "", line, column);
-      }
-      return Token(TokenType::Number, number, line, initColumn);
-
-    // Handle strings
-    if (currentChar == '\'') {
-      size_t initColumn = column;
-      std::string str;
-
-      currentChar = advance();
-      if (currentChar == EOF_CHAR) return Token(TokenType::EndOfFile, "", line, column);
-      while (currentChar != '\'') {
-        str += advance();
-        currentChar = peek();
-        if (currentChar == EOF_CHAR) return Token(TokenType::EndOfFile, "", line, column);
-      }
-      str += advance();
-      currentChar = peek();
-      if (currentChar == EOF_CHAR) return Token(TokenType::EndOfFile, "", line, column);
-      return Token(TokenType::String, str, line, initColumn);
+} // namespace
+
+Token::Token(TokenType type, std::string_view value, size_t offset)
+    : type(type), value(value), offset(offset) {}
+
+std::string Token::materialize() const {
+  return std::string(value);
+}
+
+SymbolId internToken(SymbolTable& symbols, TokenType type, std::string_view value) {
+  if (type != TokenType::Identifier && type != TokenType::String) return NO_SYMBOL;
+  return symbols.intern(value);
+}
+
+std::string formatLexError(std::string_view source, size_t offset, SourcePosition position, LexError error) {
+  const char* description = "Invalid character";
+  if (error == LexError::UnterminatedString) description = "Unterminated string";
+  if (error == LexError::UnterminatedComment) description = "Unterminated multiline comment";
+
+  size_t bkBuff = 5, fwdBuff = 50;
+  size_t snippetStart = offset > bkBuff ? offset - bkBuff : 0;
+  return std::string(description) + " at line " + std::to_string(position.line) + ", column " + std::to_string(position.column)
+      + " in src:\n..." + std::string(source.substr(snippetStart, offset + fwdBuff - snippetStart));
+}
+
+InvalidTokenError::InvalidTokenError(std::string_view src, size_t pos, SourcePosition position, LexError error)
+    : InvalidTokenError(src, pos, pos, position, error) {}
+
+InvalidTokenError::InvalidTokenError(std::string_view src, size_t snippetPos, size_t pos, SourcePosition position, LexError error)
+    : current(pos), line(position.line), column(position.column), error(error) {
+  message = "InvalidTokenError thrown: " + formatLexError(src, snippetPos, position, error);
+}
+
+void TokenStream::reserve(size_t count) {
+  kinds.reserve(count);
+  offsets.reserve(count);
+  lengths.reserve(count);
+}
+
+void TokenStream::push(TokenType kind, uint32_t offset, uint32_t length) {
+  kinds.push_back(kind);
+  offsets.push_back(offset);
+  lengths.push_back(length);
+}
+
+std::string_view TokenStream::value(size_t index) const {
+  // Strings and comments store their whole lexeme, the value leaves off the delimiters
+  size_t open = 0, close = 0;
+  switch (kinds[index]) {
+    case TokenType::String: open = 1; close = 1; break;
+    case TokenType::Comment: open = 2; break;
+    case TokenType::MultilineComment: open = 2; close = 2; break;
+    default: break;
+  }
+  return source.substr(offsets[index] + open, lengths[index] - open - close);
+}
+
+SourcePosition TokenStream::position(size_t index) const {
+  return sourceMap->position(offsets[index]);
+}
+
+const char* InvalidTokenError::what() const noexcept {
+  return message.c_str();
+}
+
+Lexer::Lexer(std::string source)
+    : Lexer(SourceBuffer::fromString(std::move(source))) {}
+
+Lexer::Lexer(SourceBuffer buffer)
+    : buffer(std::move(buffer)), scanner(this->buffer.view()), lines(std::make_unique<SourceMap>(this->buffer.view())) {}
+
+Lexer Lexer::fromFile(const std::string& path) {
+  return Lexer(SourceBuffer::fromFile(path));
+}
+
+Lexer Lexer::fromStream(std::istream& stream) {
+  return Lexer(SourceBuffer::fromStream(stream));
+}
+
+Token Lexer::nextToken() {
+  size_t before = scanner.current;
+  scanner.skipWhitespace();
+  size_t start = scanner.current;
+
+  // Handle end of the file
+  if (scanner.atEnd()) {
+    countLexed(0, start - before);
+    return Token(TokenType::EndOfFile, {}, start);
+  }
+
+  TokenType type;
+  std::string_view value;
+  for (LexError error; (error = scanner.scanToken(type, value)) != LexError::None;) {
+    if (!recovering) throwError(start, error);
+    diagnostics.push_back({start, error});
+    scanner.skipError(error);
+
+    scanner.skipWhitespace();
+    start = scanner.current;
+    if (scanner.atEnd()) {
+      countLexed(0, start - before);
+      return Token(TokenType::EndOfFile, {}, start);
     }
-    if (currentChar == '"') {
-      size_t initColumn = column;
-      std::string str;
-
-      currentChar = advance();
-      if (currentChar == EOF_CHAR) return Token(TokenType::EndOfFile, "", line, column);
-      while (currentChar != '"') {
-        str += advance();
-        currentChar = peek();
-        if (currentChar == EOF_CHAR) return Token(TokenType::EndOfFile, "", line, column);
-      }
-      str += advance();
-      currentChar = peek();
-      if (currentChar == EOF_CHAR) return Token(TokenType::EndOfFile, "", line, column);
-      return Token(TokenType::String, str, line, initColumn);
+  }
+
+  Token token(type, value, start);
+  if (symbols) token.symbol = internToken(*symbols, type, value);
+  countLexed(1, scanner.current - before);
+  return token;
+}
+
+TokenStream Lexer::tokenizeAll() {
+  PhaseTimer timer(stats, CompilePhase::Lex);
+  size_t start = scanner.current;
+  TokenStream stream = scanRest();
+  countLexed(stream.size() - 1, stream.source.length() - start);
+  return stream;
+}
+
+TokenStream Lexer::scanRest() {
+  std::string_view source = scanner.source;
+  if (source.length() > UINT32_MAX) throw std::length_error("TokenStream offsets are 32 bit, source is too large");
+
+  TokenStream stream;
+  stream.source = source;
+  stream.sourceMap = lines.get();
+  stream.reserve((source.length() - scanner.current) / 4 + 1); // Roughly one token per 4 bytes of source
+
+  if (LexError error = scanAll(scanner, stream, recovering); error != LexError::None) throwError(scanner.current, error);
+  stream.push(TokenType::EndOfFile, static_cast<uint32_t>(source.length()), 0);
+  internSymbols(stream);
+  return stream;
+}
+
+TokenStream Lexer::tokenizeParallel(size_t threadCount) {
+  std::string_view source = scanner.source;
+  if (source.length() > UINT32_MAX) throw std::length_error("TokenStream offsets are 32 bit, source is too large");
+  PhaseTimer timer(stats, CompilePhase::Lex);
+  size_t start = scanner.current;
+
+  if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+  size_t parts = std::min(threadCount, (source.length() - start) / MIN_PARALLEL_CHUNK);
+  std::vector<size_t> splits = findSplitPoints(source, start, std::max<size_t>(parts, 1));
+  if (splits.size() <= 2) {
+    TokenStream stream = scanRest();
+    countLexed(stream.size() - 1, source.length() - start);
+    return stream;
+  }
+
+  // Each chunk gets a scanner that sees the source as ending at the chunk's
+  // end, so token offsets come out the same as in one serial pass
+  size_t chunkCount = splits.size() - 1;
+  std::vector<TokenStream> chunks(chunkCount);
+  std::vector<LexError> chunkErrors(chunkCount, LexError::None);
+  std::vector<size_t> errorOffsets(chunkCount, 0);
+  auto lexChunk = [&](size_t chunk) {
+    Scanner chunkScanner(source.substr(0, splits[chunk + 1]));
+    chunkScanner.current = splits[chunk];
+    chunks[chunk].reserve((splits[chunk + 1] - splits[chunk]) / 4 + 1);
+    chunkErrors[chunk] = scanAll(chunkScanner, chunks[chunk], false);
+    errorOffsets[chunk] = chunkScanner.current;
+  };
+
+  std::vector<std::thread> workers;
+  for (size_t chunk = 1; chunk < chunkCount; chunk++) workers.emplace_back(lexChunk, chunk);
+  lexChunk(0);
+  for (std::thread& worker : workers) worker.join();
+
+  // The serial lexer would have stopped at the first error, so report that
+  // one. Recovering skips text differently to how the pre-scan assumed it
+  // would, so the split points can't be trusted and it's redone serially.
+  for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+    if (chunkErrors[chunk] == LexError::None) continue;
+    if (recovering) {
+      scanner.current = start;
+      TokenStream stream = scanRest();
+      countLexed(stream.size() - 1, source.length() - start);
+      return stream;
     }
+    scanner.current = errorOffsets[chunk];
+    throwError(scanner.current, chunkErrors[chunk]);
+  }
+  scanner.current = source.length();
+
+  TokenStream stream;
+  stream.source = source;
+  stream.sourceMap = lines.get();
+  size_t total = 1;
+  for (const TokenStream& chunk : chunks) total += chunk.size();
+  stream.reserve(total);
+  for (const TokenStream& chunk : chunks) {
+    stream.kinds.insert(stream.kinds.end(), chunk.kinds.begin(), chunk.kinds.end());
+    stream.offsets.insert(stream.offsets.end(), chunk.offsets.begin(), chunk.offsets.end());
+    stream.lengths.insert(stream.lengths.end(), chunk.lengths.begin(), chunk.lengths.end());
+  }
+  stream.push(TokenType::EndOfFile, static_cast<uint32_t>(source.length()), 0);
+  internSymbols(stream);
+  countLexed(stream.size() - 1, source.length() - start);
+  return stream;
+}
 
-    // Handle operators / comments
-    if (valueIn(currentChar, CHAR_OPERATORS)) {
-      std::string op;
-      size_t initColumn = column;
-
-      char next = peekNext();
-      if (valueIn(std::to_string(currentChar + next), STRING_OPERATORS)) { // Check if it's a multi-char operator
-        op += currentChar + next;
-        currentChar += advance();
-        if (currentChar == EOF_CHAR) return Token(TokenType::EndOfFile, "", line, column);
-        return Token(TokenType::Operator, op, line, initColumn);
-      }
-      if (currentChar == '/' && next == '/') { // Check if it's a comment
-        while (currentChar != '\n') {
-          currentChar = advance();
-          if (currentChar == EOF_CHAR) return Token(TokenType::EndOfFile, "", line, column);
+TokenStream Lexer::relex(const TokenStream& previous, const TextEdit& edit) {
+  std::string_view source = scanner.source;
+  if (source.length() > UINT32_MAX) throw std::length_error("TokenStream offsets are 32 bit, source is too large");
+  PhaseTimer timer(stats, CompilePhase::Lex);
+
+  int64_t shift = static_cast<int64_t>(edit.inserted.length()) - static_cast<int64_t>(edit.removed);
+  size_t editEnd = edit.offset + edit.inserted.length(); // End of the edited text in the new source
+  bool reuseSymbols = symbols && previous.symbols.size() == previous.size();
+
+  // Tokens that end before the edit can't have changed, they were decided by
+  // chars up to and including the one just after them. The EOF token always
+  // ends at or after the edit, so it's never in this range.
+  size_t kept = 0, last = previous.size() - 1;
+  while (kept < last) {
+    size_t mid = (kept + last) / 2;
+    if (previous.offsets[mid] + previous.lengths[mid] < edit.offset) kept = mid + 1;
+    else last = mid;
+  }
+
+  // Except that an unterminated string was decided by every char to the end
+  // of the source, so with recovery on lexing has to restart before it.
+  for (const LexDiagnostic& diagnostic : previous.errors) {
+    if (diagnostic.error != LexError::UnterminatedString || diagnostic.offset >= edit.offset) continue;
+    while (kept > 0 && previous.offsets[kept - 1] > diagnostic.offset) kept--;
+    break;
+  }
+
+  TokenStream stream;
+  stream.source = source;
+  stream.sourceMap = lines.get();
+  stream.reserve(previous.size() + edit.inserted.length() / 4 + 1);
+  stream.kinds.assign(previous.kinds.begin(), previous.kinds.begin() + kept);
+  stream.offsets.assign(previous.offsets.begin(), previous.offsets.begin() + kept);
+  stream.lengths.assign(previous.lengths.begin(), previous.lengths.begin() + kept);
+  if (reuseSymbols) stream.symbols.assign(previous.symbols.begin(), previous.symbols.begin() + kept);
+  scanner.current = kept > 0 ? previous.offsets[kept - 1] + previous.lengths[kept - 1] : 0;
+
+  // Errors before the restart point are kept too, later ones get found again
+  for (const LexDiagnostic& diagnostic : previous.errors) {
+    if (diagnostic.offset < scanner.current) stream.errors.push_back(diagnostic);
+  }
+
+  size_t old = kept; // First old token that could still line up with a new one
+  size_t restart = scanner.current;
+  size_t lexedTo = source.length(), lexedTokens = 0;
+  while (true) {
+    scanner.skipWhitespace();
+    size_t start = scanner.current;
+
+    // Past the edit the text is the same as before. Once a new token starts
+    // where an old one did, the rest of the old stream holds, just shifted.
+    if (start >= editEnd) {
+      size_t oldStart = static_cast<size_t>(static_cast<int64_t>(start) - shift);
+      while (old < previous.size() && previous.offsets[old] < oldStart) old++;
+      if (old < previous.size() && previous.offsets[old] == oldStart) {
+        lexedTo = start;
+        stream.kinds.insert(stream.kinds.end(), previous.kinds.begin() + old, previous.kinds.end());
+        stream.lengths.insert(stream.lengths.end(), previous.lengths.begin() + old, previous.lengths.end());
+        for (size_t i = old; i < previous.size(); i++) {
+          stream.offsets.push_back(static_cast<uint32_t>(previous.offsets[i] + shift));
         }
-        currentChar = advance(); // Advance again once hitting newline to go to next line
-        if (currentChar == EOF_CHAR) return Token(TokenType::EndOfFile, "", line, column);
-        return Token(TokenType::Comment, "", line, initColumn);
-      }
-      if (currentChar == '/' && next == '.') { // Check if it's a multiline comment
-        std::string comment;
-        size_t initLine = line;
-
-        while (currentChar != '.' && next != '/') {
-          comment += advance();
-          currentChar = peek();
-          if (currentChar == EOF_CHAR) return Token(TokenType::EndOfFile, "", line, column);
-          next = peekNext();
+        if (reuseSymbols) stream.symbols.insert(stream.symbols.end(), previous.symbols.begin() + old, previous.symbols.end());
+        for (const LexDiagnostic& diagnostic : previous.errors) {
+          if (diagnostic.offset >= oldStart) stream.errors.push_back({static_cast<size_t>(diagnostic.offset + shift), diagnostic.error});
         }
-        return Token(TokenType::MultilineComment, comment, initLine, initColumn);
+        break;
       }
-      // else
-      op += currentChar;
-      return Token(TokenType::Operator, op, line, initColumn);
     }
 
-    // Handle other chars
-    if (currentChar == '(') return Token(TokenType::OpenParen, "(", line, column);
-    if (currentChar == ')') return Token(TokenType::OpenParen, ")", line, column);
-    if (currentChar == '[') return Token(TokenType::OpenParen, "[", line, column);
-    if (currentChar == ']') return Token(TokenType::OpenParen, "]", line, column);
-    if (currentChar == '{') return Token(TokenType::OpenParen, "{", line, column);
-    if (currentChar == '}') return Token(TokenType::OpenParen, "}", line, column);
-    if (currentChar == ',') return Token(TokenType::Comma, ",", line, column);
-
-    // If no valid token is found, throw an exception
-    throw InvalidTokenError(source, current, line, column);
+    if (scanner.atEnd()) {
+      stream.push(TokenType::EndOfFile, static_cast<uint32_t>(source.length()), 0);
+      if (reuseSymbols) stream.symbols.push_back(NO_SYMBOL);
+      break;
+    }
+
+    TokenType type;
+    std::string_view value;
+    if (LexError error = scanner.scanToken(type, value); error != LexError::None) {
+      if (!recovering) throwError(start, error);
+      stream.errors.push_back({start, error});
+      scanner.skipError(error);
+      continue;
+    }
+    stream.push(type, static_cast<uint32_t>(start), static_cast<uint32_t>(scanner.current - start));
+    if (reuseSymbols) stream.symbols.push_back(internToken(*symbols, type, value));
+    lexedTokens++;
+  }
+
+  countLexed(lexedTokens, lexedTo - restart);
+  scanner.current = source.length();
+  if (!reuseSymbols) internSymbols(stream);
+  return stream;
+}
+
+// Interning touches shared state, so it's done as a pass over the finished stream
+void Lexer::internSymbols(TokenStream& stream) {
+  if (!symbols) return;
+  stream.symbols.reserve(stream.size());
+  for (size_t i = 0; i < stream.size(); i++) {
+    stream.symbols.push_back(internToken(*symbols, stream.kinds[i], stream.value(i)));
   }
 }
 
-private:
-  std::string source;
-  size_t current; // Current position in the source
-  size_t line;    // Current line number
-  size_t column;  // Current column number
+std::string Lexer::formatError(const LexDiagnostic& diagnostic) const {
+  return formatLexError(scanner.source, diagnostic.offset, sourceMap().position(diagnostic.offset), diagnostic.error);
+}
 
-  char peek() {return source[current];}
-  char peekNext() {return source[current + 1];}
-  char advance() {
-    if (current + 1 >= source.length()) {
-      return EOF_CHAR;
-    }
+void Lexer::countLexed(size_t tokens, size_t bytes) {
+  if (!stats) return;
+  stats->tokens += tokens;
+  stats->bytesLexed += bytes;
+}
+
+void Lexer::throwError(size_t offset, LexError error) const {
+  throw InvalidTokenError(scanner.source, offset, sourceMap().position(offset), error);
+}
+
+LexError Scanner::scanToken(TokenType& type, std::string_view& value) {
+  size_t start = current;
+  char currentChar = peek();
+
+  // Handle identifiers / keywords
+  if (isIdentifier(currentChar, true)) {
+    moveTo(skipIdentifierRun(cursor(), sourceEnd()));
+    value = slice(start);
+
+    // Keywords, types and null are reserved, anything else is user defined
+    type = RESERVED_WORDS.find(value, TokenType::Identifier);
+    return LexError::None;
+  }
+
+  // Handle numbers
+  if (hasClass(currentChar, CLASS_DIGIT)) {
+    moveTo(skipDigitRun(cursor(), sourceEnd()));
+    value = slice(start);
+    type = TokenType::Number;
+    return LexError::None;
+  }
+
+  // Handle strings, the value is the text between the quotes
+  if (currentChar == '\'' || currentChar == '"') {
+    char quote = advance();
+    size_t contentStart = current;
 
-    if (current == '\n') {
-      line++;
-      column = 0;
-    } else column++;
-    current++;
-    return source[current];
+    moveTo(findChar(cursor(), sourceEnd(), quote));
+    if (atEnd()) { // No closing quote
+      current = start;
+      return LexError::UnterminatedString;
+    }
+    value = slice(contentStart);
+    advance(); // Consume the closing quote
+    type = TokenType::String;
+    return LexError::None;
   }
-  void skipWhitespace() {
-    while (valueIn(peek(), WHITESPACE)) {
-      if (current == '\n') {
-        line++;
-        column = 0;
-      } else column++;
-      current++;
+
+  // Handle operators / comments
+  if (hasClass(currentChar, CLASS_OPERATOR)) {
+    char next = peekNext();
+
+    if (currentChar == '/' && next == '/') { // Check if it's a comment
+      advance();
+      advance();
+      size_t contentStart = current;
+      moveTo(findChar(cursor(), sourceEnd(), '\n'));
+      value = slice(contentStart);
+      type = TokenType::Comment;
+      return LexError::None;
     }
+    if (currentChar == '/' && next == '.') { // Check if it's a multiline comment
+      advance();
+      advance();
+      size_t contentStart = current;
+      moveTo(findCommentEnd(cursor(), sourceEnd()));
+      if (atEnd()) { // No closing ./
+        current = start;
+        return LexError::UnterminatedComment;
+      }
+      value = slice(contentStart);
+      advance();
+      advance();
+      type = TokenType::MultilineComment;
+      return LexError::None;
+    }
+    if (STRING_OPERATOR_TABLE.find(source.substr(current, 2), TokenType::Null) == TokenType::Operator) { // Check if it's a multi-char operator
+      advance();
+      advance();
+      value = slice(start);
+      type = TokenType::Operator;
+      return LexError::None;
+    }
+    // else
+    advance();
+    value = slice(start);
+    type = TokenType::Operator;
+    return LexError::None;
   }
-};
 
-template <typename T>
-bool valueIn(const T& value, const std::vector<T>& vec) {
-  return std::find(vec.begin(), vec.end(), value) != vec.end();
-};
+  // Handle other chars
+  switch (currentChar) {
+    case '(': type = TokenType::OpenParen; break;
+    case ')': type = TokenType::CloseParen; break;
+    case '[': type = TokenType::OpenBracket; break;
+    case ']': type = TokenType::CloseBracket; break;
+    case '{': type = TokenType::OpenBrace; break;
+    case '}': type = TokenType::CloseBrace; break;
+    case ',': type = TokenType::Comma; break;
+    // No valid token starts with this char
+    default: return LexError::InvalidCharacter;
+  }
+  advance();
+  value = slice(start);
+  return LexError::None;
+}
 
-bool isIdentifier(char ch, bool first=false) {
-  if (first) {
-    if (isdigit(ch)) return false;
-    if (!isalpha(ch) && ch != '_') return false;
+void Scanner::skipError(LexError error) {
+  switch (error) {
+    case LexError::InvalidCharacter:
+      // Skip the whole run of chars that can't start a token, so it's only reported once
+      do advance(); while (!atEnd() && CHAR_CLASSES[static_cast<unsigned char>(peek())] == 0);
+      break;
+    case LexError::UnterminatedString:
+      // Most likely a missing quote, so give up on the string at the end of its line
+      moveTo(findChar(cursor(), sourceEnd(), '\n'));
+      break;
+    case LexError::UnterminatedComment:
+      current = source.length(); // The comment runs to the end
+      break;
+    case LexError::None:
+      break;
   }
+}
+
+char Scanner::peek() const {return atEnd() ? EOF_CHAR : source[current];}
+char Scanner::peekNext() const {return current + 1 >= source.length() ? EOF_CHAR : source[current + 1];}
 
-  if (!isalpha(ch) && !isdigit(ch) && ch != '_') return false;
+void Scanner::skipWhitespace() {
+  // Most gaps are a single space, only hand off to the kernel for longer runs
+  if (!hasClass(peek(), CLASS_WHITESPACE)) return;
+  advance();
+  if (hasClass(peek(), CLASS_WHITESPACE)) moveTo(skipWhitespaceRun(cursor(), sourceEnd()));
+}
 
-  return true;
+// View of the source from start up to the current position
+std::string_view Scanner::slice(size_t start) const {
+  return source.substr(start, current - start);
 }
@@ -3,24 +3,97 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include "compile_stats.h"
+#include "source_buffer.h"
+#include "source_map.h"
+#include "symbol_table.h"
+
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 
-extern const char EOF_CHAR;
-extern const std::vector<std::string> KEYWORDS;
-extern const std::vector<char> CHAR_OPERATORS;
-extern const std::vector<std::string> STRING_OPERATORS;
-extern const std::vector<std::string> TYPES;
-extern const std::vector<char> WHITESPACE;
+// The tables are constexpr so the lexer can build its lookup tables from them
+// at compile time, see lexer.cpp
+inline constexpr char EOF_CHAR = '\0';
+inline constexpr std::string_view KEYWORDS[] = {
+  "if",
+  "elseif",
+  "else",
+  "for",
+  "in",
+  "while",
+  "fn",
+  "class",
+  "private",
+  "async",
+  "await",
+};
+inline constexpr char CHAR_OPERATORS[] = {
+  '=',
+  '+',
+  '-',
+  '*',
+  '/',
+  '>',
+  '<',
+  '@',
+  '&',
+  '|',
+  '^',
+  '!',
+  '~',
+};
+inline constexpr std::string_view STRING_OPERATORS[] = {
+  ">=",
+  "<=",
+  "==",
+  "!=",
+  "->",
+  "=>",
+  "++",
+  "--",
+  "+=",
+  "-=",
+  "*=",
+  "/=",
+  "<<",
+  ">>",
+};
+inline constexpr std::string_view TYPES[] = {
+  "int",
+  "float",
+  "complex",
+  "string",
+  "array",
+  "lockedarray",
+  "map",
+  "lockedmap",
+  "set",
+  "lockedset",
+  "bool",
+  "nulltype",
+}; // Add more when needed
+inline constexpr char WHITESPACE[] = {
+  ' ',  // U+0020
+  '\t', // U+0009
+  '\n', // U+000A
+  '\r', // U+000D
+  '\v', // U+000B
+  '\f', // U+000C
+};
 
-enum class TokenType {
+enum class TokenType : uint8_t {
   Identifier,
   Keyword,
   Number,
   String,
   Operator,
   Comment,
-  MultilineComment,
+  MultilineComment, // We track multiline comments separately since they're used for docstrings
   OpenParen,
   CloseParen,
   OpenBracket,
@@ -33,30 +106,185 @@ enum class TokenType {
   Type,
 };
 
+// Tokens don't own their text, value is a view into the source buffer of the
+// Lexer that produced them and is only valid for as long as that Lexer is.
+// Lines and columns aren't tracked while lexing, ask the Lexer for them.
 struct Token {
   TokenType type;
-  std::string value;
-  size_t line;
-  size_t column;
+  std::string_view value;
+  size_t offset;                // Offset of the token's first char in the source
+  SymbolId symbol = NO_SYMBOL;  // Interned value of identifiers and strings, if the lexer has a SymbolTable
+
+  Token(TokenType type, std::string_view value, size_t offset);
+
+  // Copy the token's text out of the source buffer
+  std::string materialize() const;
+};
+
+// Why a token couldn't be scanned
+enum class LexError : uint8_t {
+  None,
+  InvalidCharacter,
+  UnterminatedString,
+  UnterminatedComment,
+};
 
-  Token(TokenType type, const std::string& value, size_t line, size_t column);
+// An error found while lexing with recovery on. Only the offset and the kind
+// of error are kept, the message is worked out if someone asks for it.
+struct LexDiagnostic {
+  size_t offset;
+  LexError error;
+};
+
+// Every token in a source stored as parallel arrays, so walking it touches 9
+// bytes per token instead of a whole Token. Values are views into source and
+// lines/columns are only worked out when asked for. The stream always ends
+// with an EndOfFile token.
+struct TokenStream {
+  std::vector<TokenType> kinds;
+  std::vector<uint32_t> offsets;    // Offset of the first char of each token
+  std::vector<uint32_t> lengths; // Length of each token, including any quotes or comment markers
+  std::vector<SymbolId> symbols; // Same as Token::symbol, only filled if the lexer has a SymbolTable
+  std::vector<LexDiagnostic> errors; // Only filled if the lexer is recovering from errors
+  std::string_view source;
+  const SourceMap* sourceMap = nullptr;
+
+  size_t size() const {return kinds.size();}
+  void reserve(size_t count);
+  void push(TokenType kind, uint32_t offset, uint32_t length);
+
+  // Same text as Token::value
+  std::string_view value(size_t index) const;
+  SourcePosition position(size_t index) const;
+};
+
+// The scanning loop behind every lexer. It works on any view of source text
+// and reports errors instead of throwing, so each lexer can decide what to do
+// about them.
+class Scanner {
+public:
+  std::string_view source;
+  size_t current = 0; // Current position in the source
+
+  Scanner() = default;
+  explicit Scanner(std::string_view source) : source(source) {}
+
+  bool atEnd() const {return current >= source.length();}
+  void skipWhitespace();
+  // Scans the token at the current position, which must not be whitespace or
+  // the end of the source. Sets type and value and moves past the token, or
+  // leaves the position at the token's start and returns what went wrong.
+  LexError scanToken(TokenType& type, std::string_view& value);
+  // Skips past the text that caused error, so lexing can carry on after it
+  void skipError(LexError error);
+
+private:
+  char peek() const;
+  char peekNext() const;
+  char advance() {return source[current++];}
+  const char* cursor() const {return source.data() + current;}
+  const char* sourceEnd() const {return source.data() + source.length();}
+  void moveTo(const char* ch) {current = ch - source.data();}
+  std::string_view slice(size_t start) const;
+};
+
+// A change to a source, removed bytes at offset were replaced with inserted
+struct TextEdit {
+  size_t offset;
+  size_t removed;
+  std::string_view inserted;
+};
+
+// Interns value into symbols if it's an identifier or string, otherwise NO_SYMBOL
+SymbolId internToken(SymbolTable& symbols, TokenType type, std::string_view value);
+
+// "Unterminated string at line 3, column 4 in src:" followed by the source around offset
+std::string formatLexError(std::string_view source, size_t offset, SourcePosition position, LexError error);
+
+class InvalidTokenError : public std::exception {
+  private:
+    std::string message;
+    size_t current, line, column;
+    LexError error;
+
+  public:
+    InvalidTokenError(std::string_view src, size_t pos, SourcePosition position, LexError error);
+    // For when src is only part of the input, snippetPos is where the error is in src and pos where it is in the whole input
+    InvalidTokenError(std::string_view src, size_t snippetPos, size_t pos, SourcePosition position, LexError error);
+
+    LexError code() const {return error;}
+    size_t offset() const {return current;} // From the start of the whole input
+    SourcePosition position() const {return {line, column};}
+
+    const char* what() const noexcept override;
 };
 
 class Lexer {
 public:
-  Lexer(const std::string& source);
-  Token Lexer::nextToken();
+  Lexer(std::string source);
+  explicit Lexer(SourceBuffer buffer);
+
+  // Lex a file without copying it, straight out of a read-only mapping
+  static Lexer fromFile(const std::string& path);
+  // Lex stdin or a pipe, which has to be read into memory first
+  static Lexer fromStream(std::istream& stream);
+
+  // Tokens point into source, so the lexer can't be copied out from under
+  // them. Moving is fine since the buffer's bytes stay put.
+  Lexer(const Lexer&) = delete;
+  Lexer& operator=(const Lexer&) = delete;
+  Lexer(Lexer&&) = default;
+  Lexer& operator=(Lexer&&) = default;
+
+  Token nextToken();
+  // Lex the rest of the source in one go. The stream views into this lexer's
+  // source, the same as Token does.
+  TokenStream tokenizeAll();
+  // Same result as tokenizeAll, but a large source is split into chunks that
+  // are lexed on threadCount threads (0 for one per core)
+  TokenStream tokenizeParallel(size_t threadCount = 0);
+  // Same result as tokenizeAll for a source that is previous's source with
+  // edit applied, but only the tokens around the edit are lexed again, the
+  // rest are taken from previous. Lexing restarts after the last token that
+  // ends before the edit and stops as soon as a new token starts where an old
+  // one did past the edit, since the scanner carries no state between tokens.
+  TokenStream relex(const TokenStream& previous, const TextEdit& edit);
+
+  // Instead of throwing InvalidTokenError, note each error, skip the bad text
+  // and keep lexing, so one pass finds every error in the source. Errors from
+  // nextToken go in errors(), a TokenStream keeps its own.
+  void recoverFromErrors(bool enabled = true) {recovering = enabled;}
+  const std::vector<LexDiagnostic>& errors() const {return diagnostics;}
+  std::string formatError(const LexDiagnostic& diagnostic) const;
+
+  // Intern identifiers and strings into table from now on. The table has to
+  // outlive the lexer and can be shared between the lexers of several files.
+  void useSymbolTable(SymbolTable& table) {symbols = &table;}
+  // Stop interning, for when the table is about to go away
+  void clearSymbolTable() {symbols = nullptr;}
+  // Count tokens and bytes lexed into stats from now on, and time the batch
+  // APIs as the Lex phase. nextToken is counted but not timed, since reading
+  // the clock would cost as much as lexing the token.
+  void useStats(CompileStats& compileStats) {stats = &compileStats;}
+  void clearStats() {stats = nullptr;}
+
+  // Line index of the source, built the first time a position is asked for
+  const SourceMap& sourceMap() const {return *lines;}
+  SourcePosition position(const Token& token) const {return lines->position(token.offset);}
 
 private:
-  std::string source;
-  size_t current;
-  size_t line;
-  size_t column;
-
-  char peek();
-  char peekNext();
-  char advance();
-  void skipWhitespace();
+  SourceBuffer buffer;
+  Scanner scanner; // Scans a view of buffer
+  std::unique_ptr<SourceMap> lines; // On the heap so streams can point to it as the lexer moves
+  SymbolTable* symbols = nullptr;
+  CompileStats* stats = nullptr;
+  bool recovering = false;
+  std::vector<LexDiagnostic> diagnostics;
+
+  TokenStream scanRest(); // tokenizeAll without counting it in stats
+  void countLexed(size_t tokens, size_t bytes);
+  void throwError(size_t offset, LexError error) const;
+  void internSymbols(TokenStream& stream);
 };
 
-#endif // LEXER_H
\ No newline at end of file
+#endif // LEXER_H
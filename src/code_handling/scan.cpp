@@ -0,0 +1,184 @@
+// scan.cpp
+
+#include "scan.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__)
+  #include <immintrin.h>
+  #define SCAN_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define SCAN_SSE2
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+  #include <arm_neon.h>
+  #define SCAN_NEON
+#endif
+
+#if defined(_MSC_VER)
+  #include <intrin.h>
+#endif
+
+namespace {
+
+bool isWhitespace(char ch) {return ch == ' ' || (ch >= '\t' && ch <= '\r');}
+bool isDigit(char ch) {return ch >= '0' && ch <= '9';}
+bool isIdentifier(char ch) {
+  return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || isDigit(ch) || ch == '_';
+}
+
+#if defined(SCAN_AVX2) || defined(SCAN_SSE2) || defined(SCAN_NEON)
+#define SCAN_SIMD
+
+size_t countTrailingZeros(uint64_t bits) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward64(&index, bits);
+  return index;
+#else
+  return __builtin_ctzll(bits);
+#endif
+}
+
+// A block is a vector of bytes, comparisons give 0xFF in every byte that matches
+#if defined(SCAN_AVX2)
+using Block = __m256i;
+constexpr ptrdiff_t BLOCK_SIZE = 32;
+
+Block load(const char* ch) {return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ch));}
+Block splat(char ch) {return _mm256_set1_epi8(ch);}
+Block equal(Block block, char ch) {return _mm256_cmpeq_epi8(block, splat(ch));}
+Block either(Block a, Block b) {return _mm256_or_si256(a, b);}
+Block both(Block a, Block b) {return _mm256_and_si256(a, b);}
+// lo <= byte <= hi, as an unsigned compare on byte - lo
+Block between(Block block, char lo, char hi) {
+  Block shifted = _mm256_sub_epi8(block, splat(lo));
+  return _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, splat(hi - lo)), shifted);
+}
+// One bit per byte
+uint64_t matchBits(Block matches) {return static_cast<uint32_t>(_mm256_movemask_epi8(matches));}
+constexpr size_t BITS_PER_BYTE = 1;
+constexpr uint64_t ALL_BITS = 0xFFFFFFFF;
+#elif defined(SCAN_SSE2)
+using Block = __m128i;
+constexpr ptrdiff_t BLOCK_SIZE = 16;
+
+Block load(const char* ch) {return _mm_loadu_si128(reinterpret_cast<const __m128i*>(ch));}
+Block splat(char ch) {return _mm_set1_epi8(ch);}
+Block equal(Block block, char ch) {return _mm_cmpeq_epi8(block, splat(ch));}
+Block either(Block a, Block b) {return _mm_or_si128(a, b);}
+Block both(Block a, Block b) {return _mm_and_si128(a, b);}
+Block between(Block block, char lo, char hi) {
+  Block shifted = _mm_sub_epi8(block, splat(lo));
+  return _mm_cmpeq_epi8(_mm_min_epu8(shifted, splat(hi - lo)), shifted);
+}
+uint64_t matchBits(Block matches) {return static_cast<uint32_t>(_mm_movemask_epi8(matches));}
+constexpr size_t BITS_PER_BYTE = 1;
+constexpr uint64_t ALL_BITS = 0xFFFF;
+#elif defined(SCAN_NEON)
+using Block = uint8x16_t;
+constexpr ptrdiff_t BLOCK_SIZE = 16;
+
+Block load(const char* ch) {return vld1q_u8(reinterpret_cast<const uint8_t*>(ch));}
+Block splat(char ch) {return vdupq_n_u8(static_cast<uint8_t>(ch));}
+Block equal(Block block, char ch) {return vceqq_u8(block, splat(ch));}
+Block either(Block a, Block b) {return vorrq_u8(a, b);}
+Block both(Block a, Block b) {return vandq_u8(a, b);}
+Block between(Block block, char lo, char hi) {return vandq_u8(vcgeq_u8(block, splat(lo)), vcleq_u8(block, splat(hi)));}
+// NEON has no movemask, narrowing each byte to a nibble gets the same answer with 4 bits per byte
+uint64_t matchBits(Block matches) {
+  uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(matches), 4);
+  return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+}
+constexpr size_t BITS_PER_BYTE = 4;
+constexpr uint64_t ALL_BITS = ~uint64_t(0);
+#endif
+
+// Index of the first matching byte in a block, or BLOCK_SIZE if none match
+ptrdiff_t firstMatch(Block matches) {
+  uint64_t bits = matchBits(matches);
+  return bits ? countTrailingZeros(bits) / BITS_PER_BYTE : BLOCK_SIZE;
+}
+
+// Index of the first byte that doesn't match, or BLOCK_SIZE if they all do
+ptrdiff_t firstMiss(Block matches) {
+  uint64_t bits = matchBits(matches) ^ ALL_BITS;
+  return bits ? countTrailingZeros(bits) / BITS_PER_BYTE : BLOCK_SIZE;
+}
+#endif
+
+} // namespace
+
+const char* skipWhitespaceRun(const char* ch, const char* end) {
+#ifdef SCAN_SIMD
+  for (; end - ch >= BLOCK_SIZE; ch += BLOCK_SIZE) {
+    Block block = load(ch);
+    ptrdiff_t index = firstMiss(either(equal(block, ' '), between(block, '\t', '\r')));
+    if (index < BLOCK_SIZE) return ch + index;
+  }
+#endif
+  while (ch < end && isWhitespace(*ch)) ch++;
+  return ch;
+}
+
+const char* skipIdentifierRun(const char* ch, const char* end) {
+#ifdef SCAN_SIMD
+  for (; end - ch >= BLOCK_SIZE; ch += BLOCK_SIZE) {
+    Block block = load(ch);
+    Block letters = either(between(block, 'a', 'z'), between(block, 'A', 'Z'));
+    ptrdiff_t index = firstMiss(either(either(letters, between(block, '0', '9')), equal(block, '_')));
+    if (index < BLOCK_SIZE) return ch + index;
+  }
+#endif
+  while (ch < end && isIdentifier(*ch)) ch++;
+  return ch;
+}
+
+const char* skipDigitRun(const char* ch, const char* end) {
+#ifdef SCAN_SIMD
+  for (; end - ch >= BLOCK_SIZE; ch += BLOCK_SIZE) {
+    ptrdiff_t index = firstMiss(between(load(ch), '0', '9'));
+    if (index < BLOCK_SIZE) return ch + index;
+  }
+#endif
+  while (ch < end && isDigit(*ch)) ch++;
+  return ch;
+}
+
+const char* findChar(const char* ch, const char* end, char target) {
+#ifdef SCAN_SIMD
+  for (; end - ch >= BLOCK_SIZE; ch += BLOCK_SIZE) {
+    ptrdiff_t index = firstMatch(equal(load(ch), target));
+    if (index < BLOCK_SIZE) return ch + index;
+  }
+#endif
+  while (ch < end && *ch != target) ch++;
+  return ch;
+}
+
+const char* findCommentEnd(const char* ch, const char* end) {
+#ifdef SCAN_SIMD
+  // Compare each byte and the one after it, so a block needs one byte of lookahead
+  for (; end - ch > BLOCK_SIZE; ch += BLOCK_SIZE) {
+    ptrdiff_t index = firstMatch(both(equal(load(ch), '.'), equal(load(ch + 1), '/')));
+    if (index < BLOCK_SIZE) return ch + index;
+  }
+#endif
+  for (; end - ch >= 2; ch++) {
+    if (ch[0] == '.' && ch[1] == '/') return ch;
+  }
+  return end;
+}
+
+const char* findQuoteOrSlash(const char* ch, const char* end) {
+#ifdef SCAN_SIMD
+  for (; end - ch >= BLOCK_SIZE; ch += BLOCK_SIZE) {
+    Block block = load(ch);
+    ptrdiff_t index = firstMatch(either(either(equal(block, '\''), equal(block, '"')), equal(block, '/')));
+    if (index < BLOCK_SIZE) return ch + index;
+  }
+#endif
+  while (ch < end && *ch != '\'' && *ch != '"' && *ch != '/') ch++;
+  return ch;
+}
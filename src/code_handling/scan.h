@@ -0,0 +1,24 @@
+// scan.h
+
+#ifndef SCAN_H
+#define SCAN_H
+
+// Skip-ahead kernels for the lexer's long runs. Each one looks at a block of
+// 16 or 32 bytes at a time with SSE2, AVX2 or NEON, whichever the build
+// targets, and falls back to a plain loop for the tail and on other targets.
+// All of them return end if the run doesn't stop before it.
+
+// First char that isn't whitespace
+const char* skipWhitespaceRun(const char* ch, const char* end);
+// First char that can't be part of an identifier
+const char* skipIdentifierRun(const char* ch, const char* end);
+// First char that isn't a digit
+const char* skipDigitRun(const char* ch, const char* end);
+// First occurrence of target, used for newlines and closing quotes
+const char* findChar(const char* ch, const char* end, char target);
+// First "./" that closes a multiline comment
+const char* findCommentEnd(const char* ch, const char* end);
+// First quote or slash, either of which could start a string or comment
+const char* findQuoteOrSlash(const char* ch, const char* end);
+
+#endif // SCAN_H
@@ -0,0 +1,193 @@
+// source_buffer.cpp
+
+#include "source_buffer.h"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+#if defined(_WIN32)
+  #define NOMINMAX
+  #include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+  #include <cerrno>
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+  #define SOURCE_BUFFER_POSIX
+#endif
+
+namespace {
+
+constexpr uint64_t HASH_PRIME_1 = 0x9E3779B185EBCA87ull;
+constexpr uint64_t HASH_PRIME_2 = 0xC2B2AE3D27D4EB4Full;
+
+uint64_t rotateLeft(uint64_t value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+uint64_t readWord(const char* bytes) {
+  uint64_t word;
+  std::memcpy(&word, bytes, sizeof(word));
+  return word;
+}
+
+// The xxHash64 round, mixes one word into a lane
+uint64_t hashRound(uint64_t lane, uint64_t word) {
+  return rotateLeft(lane + word * HASH_PRIME_2, 31) * HASH_PRIME_1;
+}
+
+} // namespace
+
+SourceBuffer SourceBuffer::fromFile(const std::string& path) {
+  SourceBuffer buffer;
+
+#if defined(_WIN32)
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) throw std::runtime_error("Couldn't open " + path);
+
+  LARGE_INTEGER size{};
+  bool sized = GetFileSizeEx(file, &size);
+  if (sized && size.QuadPart > 0) {
+    HANDLE fileMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (fileMapping != nullptr) {
+      buffer.mapping = MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+      CloseHandle(fileMapping); // The view keeps the mapping alive
+    }
+    if (buffer.mapping != nullptr) {
+      buffer.begin = static_cast<const char*>(buffer.mapping);
+      buffer.length = static_cast<size_t>(size.QuadPart);
+    }
+  }
+  CloseHandle(file);
+  if (buffer.mapping != nullptr || (sized && size.QuadPart == 0)) return buffer;
+#elif defined(SOURCE_BUFFER_POSIX)
+  int file = open(path.c_str(), O_RDONLY);
+  if (file < 0) throw std::runtime_error("Couldn't open " + path);
+
+  // Only regular files can be mapped, fifos and devices (/dev/stdin) are read
+  // below. Anything else, like a directory, would read as an empty source.
+  struct stat info;
+  if (fstat(file, &info) != 0 || !(S_ISREG(info.st_mode) || S_ISFIFO(info.st_mode) || S_ISCHR(info.st_mode))) {
+    close(file);
+    throw std::runtime_error("Couldn't read " + path + ", it isn't a file");
+  }
+  bool regular = S_ISREG(info.st_mode);
+
+  if (!regular) {
+    // Read from this descriptor, opening a fifo again would wait for a new writer
+    std::string text;
+    char chunk[64 * 1024];
+    ssize_t count;
+    while ((count = read(file, chunk, sizeof(chunk))) != 0) {
+      if (count < 0 && errno == EINTR) continue;
+      if (count < 0) {
+        close(file);
+        throw std::runtime_error("Couldn't read " + path);
+      }
+      text.append(chunk, static_cast<size_t>(count));
+    }
+    close(file);
+    return fromString(std::move(text));
+  }
+  if (regular && info.st_size > 0) {
+    void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    if (mapped != MAP_FAILED) {
+      buffer.mapping = mapped;
+      buffer.begin = static_cast<const char*>(mapped);
+      buffer.length = static_cast<size_t>(info.st_size);
+      madvise(mapped, buffer.length, MADV_SEQUENTIAL); // The lexer reads front to back
+    }
+  }
+  close(file);
+  if (buffer.mapping != nullptr || info.st_size == 0) return buffer;
+#endif
+
+  // Couldn't map it, read it in the normal way instead
+  std::ifstream stream(path, std::ios::binary);
+  if (!stream) throw std::runtime_error("Couldn't open " + path);
+  try {
+    return fromStream(stream);
+  } catch (const std::runtime_error&) {
+    throw std::runtime_error("Couldn't read " + path);
+  }
+}
+
+SourceBuffer SourceBuffer::fromStream(std::istream& stream) {
+  // Read in fixed-size chunks since the size of a pipe isn't known up front
+  std::string text;
+  char chunk[64 * 1024];
+  while (stream.read(chunk, sizeof(chunk)) || stream.gcount() > 0) {
+    text.append(chunk, static_cast<size_t>(stream.gcount()));
+  }
+  // eof and fail are set at the end of the input, bad only on a read error
+  if (stream.bad()) throw std::runtime_error("Couldn't read source stream");
+  return fromString(std::move(text));
+}
+
+SourceBuffer SourceBuffer::fromString(std::string text) {
+  SourceBuffer buffer;
+  buffer.owned = std::make_unique<std::string>(std::move(text));
+  buffer.begin = buffer.owned->data();
+  buffer.length = buffer.owned->length();
+  return buffer;
+}
+
+SourceBuffer::SourceBuffer(SourceBuffer&& other) noexcept
+    : begin(other.begin), length(other.length), mapping(other.mapping), owned(std::move(other.owned)) {
+  other.begin = nullptr;
+  other.length = 0;
+  other.mapping = nullptr;
+}
+
+SourceBuffer& SourceBuffer::operator=(SourceBuffer&& other) noexcept {
+  if (this != &other) {
+    release();
+    begin = std::exchange(other.begin, nullptr);
+    length = std::exchange(other.length, 0);
+    mapping = std::exchange(other.mapping, nullptr);
+    owned = std::move(other.owned);
+  }
+  return *this;
+}
+
+SourceBuffer::~SourceBuffer() {
+  release();
+}
+
+void SourceBuffer::release() {
+  if (mapping != nullptr) {
+#if defined(_WIN32)
+    UnmapViewOfFile(mapping);
+#elif defined(SOURCE_BUFFER_POSIX)
+    munmap(mapping, length);
+#endif
+    mapping = nullptr;
+  }
+  owned.reset();
+  begin = nullptr;
+  length = 0;
+}
+
+uint64_t SourceBuffer::contentHash() const {
+  // Four lanes with no dependency on each other, so the multiplies overlap
+  uint64_t lanes[4] = {HASH_PRIME_1 + HASH_PRIME_2, HASH_PRIME_2, 0, HASH_PRIME_1};
+  size_t i = 0;
+  for (; i + 32 <= length; i += 32) {
+    for (size_t lane = 0; lane < 4; lane++) lanes[lane] = hashRound(lanes[lane], readWord(begin + i + lane * 8));
+  }
+
+  uint64_t hash = length;
+  for (size_t lane = 0; lane < 4; lane++) hash = rotateLeft(hash ^ hashRound(0, lanes[lane]), 27) * HASH_PRIME_1;
+  for (; i + 8 <= length; i += 8) hash = rotateLeft(hash ^ hashRound(0, readWord(begin + i)), 27) * HASH_PRIME_1;
+  for (; i < length; i++) hash = rotateLeft(hash ^ (static_cast<unsigned char>(begin[i]) * HASH_PRIME_2), 11) * HASH_PRIME_1;
+
+  // Spread every bit of the lanes over the whole result
+  hash ^= hash >> 33;
+  hash *= HASH_PRIME_2;
+  hash ^= hash >> 29;
+  hash *= HASH_PRIME_1;
+  return hash ^ (hash >> 32);
+}
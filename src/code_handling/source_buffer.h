@@ -0,0 +1,46 @@
+// source_buffer.h
+
+#ifndef SOURCE_BUFFER_H
+#define SOURCE_BUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Read-only bytes of a source, either mapped straight from a file or owned.
+// The bytes never move, even when the buffer itself is moved, so views into
+// them stay valid for as long as the buffer lives.
+class SourceBuffer {
+public:
+  // Map the file read-only. Falls back to reading it if it can't be mapped.
+  static SourceBuffer fromFile(const std::string& path);
+  // Read everything left in the stream, for stdin and pipes which can't be mapped
+  static SourceBuffer fromStream(std::istream& stream);
+  static SourceBuffer fromString(std::string text);
+
+  SourceBuffer(SourceBuffer&& other) noexcept;
+  SourceBuffer& operator=(SourceBuffer&& other) noexcept;
+  SourceBuffer(const SourceBuffer&) = delete;
+  SourceBuffer& operator=(const SourceBuffer&) = delete;
+  ~SourceBuffer();
+
+  std::string_view view() const {return std::string_view(begin, length);}
+  bool isMapped() const {return mapping != nullptr;}
+  // 64 bit hash of the bytes, for keying caches of compiled code. Fast rather
+  // than cryptographic, and it differs between little and big endian machines.
+  uint64_t contentHash() const;
+
+private:
+  SourceBuffer() = default;
+  void release();
+
+  const char* begin = nullptr;
+  size_t length = 0;
+  void* mapping = nullptr;             // Start of the mapped view, if mapped
+  std::unique_ptr<std::string> owned;  // Text we read ourselves, if not mapped
+};
+
+#endif // SOURCE_BUFFER_H
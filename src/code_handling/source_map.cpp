@@ -0,0 +1,33 @@
+// source_map.cpp
+
+#include "source_map.h"
+
+#include <algorithm>
+#include <cstring>
+
+const std::vector<size_t>& SourceMap::index() const {
+  std::call_once(built, [this]() {
+    lineStarts.push_back(0);
+
+    // memchr is vectorized by the standard library, so let it find the newlines
+    const char* begin = source.data();
+    const char* end = begin + source.length();
+    for (const char* ch = begin; ch < end; ch++) {
+      ch = static_cast<const char*>(std::memchr(ch, '\n', end - ch));
+      if (ch == nullptr) break;
+      lineStarts.push_back(ch - begin + 1);
+    }
+  });
+  return lineStarts;
+}
+
+SourcePosition SourceMap::position(size_t offset) const {
+  // The line is the last line start at or before the offset
+  const std::vector<size_t>& starts = index();
+  auto lineStart = std::upper_bound(starts.begin(), starts.end(), offset) - 1;
+  return {static_cast<size_t>(lineStart - starts.begin()) + 1, offset - *lineStart};
+}
+
+size_t SourceMap::offset(SourcePosition position) const {
+  return lineStart(position.line) + position.column;
+}
@@ -0,0 +1,43 @@
+// source_map.h
+
+#ifndef SOURCE_MAP_H
+#define SOURCE_MAP_H
+
+#include <cstddef>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+// Lines count from 1 and columns from 0
+struct SourcePosition {
+  size_t line;
+  size_t column;
+};
+
+// Index of where every line of a source starts, so offsets can be turned into
+// lines and columns only when something (an error message, a debugger, an
+// editor) actually needs them. Making one is free, the index is built in one
+// pass the first time it's asked for, which is safe from several threads.
+// source has to outlive the map.
+class SourceMap {
+public:
+  SourceMap() = default;
+  explicit SourceMap(std::string_view source) : source(source) {}
+  SourceMap(const SourceMap&) = delete;
+  SourceMap& operator=(const SourceMap&) = delete;
+
+  SourcePosition position(size_t offset) const;
+  size_t offset(SourcePosition position) const;
+
+  size_t lineCount() const {return index().size();}
+  size_t lineStart(size_t line) const {return index()[line - 1];}
+
+private:
+  std::string_view source;
+  mutable std::once_flag built;
+  mutable std::vector<size_t> lineStarts; // Offset of the first char of each line
+
+  const std::vector<size_t>& index() const;
+};
+
+#endif // SOURCE_MAP_H
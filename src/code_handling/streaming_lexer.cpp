@@ -0,0 +1,145 @@
+// streaming_lexer.cpp
+
+#include "streaming_lexer.h"
+#include "scan.h"
+
+#include <algorithm>
+#include <utility>
+
+StreamingLexer::StreamingLexer(std::istream& stream, size_t chunkSize)
+    : StreamingLexer([&stream](char* buffer, size_t capacity) {
+        stream.read(buffer, static_cast<std::streamsize>(capacity));
+        return static_cast<size_t>(stream.gcount());
+      }, chunkSize) {}
+
+StreamingLexer::StreamingLexer(ChunkReader reader, size_t chunkSize)
+    : reader(std::move(reader)), chunkSize(std::max<size_t>(chunkSize, 1)) {
+  readerThread = std::thread(&StreamingLexer::readChunks, this);
+}
+
+StreamingLexer::~StreamingLexer() {
+  {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    stopping = true;
+  }
+  queueChanged.notify_all();
+  readerThread.join(); // Waits out a read that's already in progress
+}
+
+Token StreamingLexer::nextToken() {
+  while (true) {
+    scanner.skipWhitespace();
+    size_t start = scanner.current;
+
+    if (scanner.atEnd()) {
+      if (!atInputEnd) {
+        refill();
+        continue;
+      }
+      countLines(start);
+      lastPosition = {line, windowStart + start - lineStart};
+      return Token(TokenType::EndOfFile, {}, windowStart + start);
+    }
+
+    TokenType type;
+    std::string_view value;
+    LexError error = scanner.scanToken(type, value);
+
+    // A token that runs into the end of the window might carry on in the next chunk
+    bool incomplete = error == LexError::UnterminatedString || error == LexError::UnterminatedComment || scanner.atEnd();
+    if (incomplete && !atInputEnd) {
+      scanner.current = start;
+      refill();
+      continue;
+    }
+
+    countLines(start);
+    lastPosition = {line, windowStart + start - lineStart};
+    if (error != LexError::None) throw InvalidTokenError(window, start, windowStart + start, lastPosition, error);
+
+    Token token(type, value, windowStart + start);
+    if (symbols) token.symbol = internToken(*symbols, type, value);
+    return token;
+  }
+}
+
+void StreamingLexer::readChunks() {
+  try {
+    while (true) {
+      {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (stopping) return;
+      }
+
+      // Read without holding the lock so the lexer can keep pulling queued chunks
+      std::string chunk(chunkSize, '\0');
+      chunk.resize(reader(chunk.data(), chunk.size()));
+
+      std::unique_lock<std::mutex> lock(queueMutex);
+      if (chunk.empty()) {
+        inputDone = true;
+        queueChanged.notify_all();
+        return;
+      }
+      queueChanged.wait(lock, [this] {return queue.size() < MAX_QUEUED || stopping;});
+      if (stopping) return;
+      queue.push_back(std::move(chunk));
+      queueChanged.notify_all();
+    }
+  } catch (...) {
+    // Hand the error to the lexer thread, it's rethrown from nextToken
+    std::lock_guard<std::mutex> lock(queueMutex);
+    readError = std::current_exception();
+    inputDone = true;
+    queueChanged.notify_all();
+  }
+}
+
+// Appends the next chunk to the window, returns false once the input has run out
+bool StreamingLexer::pullChunk() {
+  std::unique_lock<std::mutex> lock(queueMutex);
+  queueChanged.wait(lock, [this] {return !queue.empty() || inputDone;});
+  if (queue.empty()) {
+    if (readError) std::rethrow_exception(readError);
+    return false;
+  }
+
+  std::string chunk = std::move(queue.front());
+  queue.pop_front();
+  lock.unlock();
+  queueChanged.notify_all();
+
+  window += chunk;
+  return true;
+}
+
+// Drops the lexed part of the window and reads more after what's left
+void StreamingLexer::refill() {
+  countLines(scanner.current);
+  window.erase(0, scanner.current);
+  windowStart += scanner.current;
+
+  // Grow by at least what's already buffered, so a token longer than a chunk
+  // only gets rescanned a logarithmic number of times
+  size_t target = window.size() + std::max(chunkSize, window.size());
+  while (window.size() < target) {
+    if (!pullChunk()) {
+      atInputEnd = true;
+      break;
+    }
+  }
+  scanner = Scanner(window);
+}
+
+// Counts the newlines in the window up to upTo, which can't be before the last count
+void StreamingLexer::countLines(size_t upTo) {
+  const char* begin = window.data();
+  const char* end = begin + upTo;
+  for (const char* ch = begin + (counted - windowStart); ; ch++) {
+    ch = findChar(ch, end, '\n');
+    if (ch == end) break;
+    line++;
+    lineStart = windowStart + (ch - begin) + 1;
+  }
+  counted = windowStart + upTo;
+}
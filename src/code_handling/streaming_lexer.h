@@ -0,0 +1,80 @@
+// streaming_lexer.h
+
+#ifndef STREAMING_LEXER_H
+#define STREAMING_LEXER_H
+
+#include "lexer.h"
+#include "source_map.h"
+#include "symbol_table.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <istream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Lexes input that arrives in chunks, such as a script piped into the
+// interpreter, without ever holding all of it. A background thread reads the
+// next chunks while the current one is lexed, and only the unlexed tail of the
+// input is kept, so memory stays around two chunks plus the longest token.
+class StreamingLexer {
+public:
+  // Fills buffer with up to capacity bytes and returns how many it wrote, 0 at the end of the input
+  using ChunkReader = std::function<size_t(char* buffer, size_t capacity)>;
+
+  static constexpr size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+
+  explicit StreamingLexer(std::istream& stream, size_t chunkSize = DEFAULT_CHUNK_SIZE);
+  explicit StreamingLexer(ChunkReader reader, size_t chunkSize = DEFAULT_CHUNK_SIZE);
+  ~StreamingLexer();
+
+  StreamingLexer(const StreamingLexer&) = delete;
+  StreamingLexer& operator=(const StreamingLexer&) = delete;
+
+  // Unlike Lexer, a token's value is only valid until the next call, since
+  // the text it views gets dropped once it has been lexed. Token::offset is
+  // from the start of the whole input.
+  Token nextToken();
+  // Line and column of the last token returned
+  SourcePosition position() const {return lastPosition;}
+
+  // Intern identifiers and strings into table, which outlives the token text
+  void useSymbolTable(SymbolTable& table) {symbols = &table;}
+
+private:
+  ChunkReader reader;
+  size_t chunkSize;
+  SymbolTable* symbols = nullptr;
+
+  // Filled by the reader thread, at most MAX_QUEUED chunks ahead of the lexer
+  static constexpr size_t MAX_QUEUED = 2;
+  std::thread readerThread;
+  std::mutex queueMutex;
+  std::condition_variable queueChanged;
+  std::deque<std::string> queue;
+  bool inputDone = false;
+  bool stopping = false;
+  std::exception_ptr readError;
+
+  std::string window;      // Input that hasn't been lexed yet
+  size_t windowStart = 0;  // Offset of window[0] in the whole input
+  Scanner scanner;         // Scans window
+  bool atInputEnd = false; // Everything has been read into window
+
+  // Newlines are counted up to counted, as lines are dropped from the window
+  size_t counted = 0;
+  size_t line = 1;
+  size_t lineStart = 0;
+  SourcePosition lastPosition{1, 0};
+
+  void readChunks();
+  bool pullChunk();
+  void refill();
+  void countLines(size_t upTo);
+};
+
+#endif // STREAMING_LEXER_H
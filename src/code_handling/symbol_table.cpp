@@ -0,0 +1,176 @@
+// symbol_table.cpp
+
+#include "symbol_table.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+
+#if defined(_MSC_VER)
+  #include <intrin.h>
+#endif
+
+namespace {
+
+constexpr uint64_t LOW_BITS = 0x0101010101010101ull;
+constexpr uint64_t HIGH_BITS = 0x8080808080808080ull;
+
+size_t hashText(std::string_view text) {return std::hash<std::string_view>()(text);}
+
+// Control bytes of a group as a word, with the first slot in the lowest byte
+uint64_t loadGroup(const uint8_t* controls) {
+  uint64_t group;
+  std::memcpy(&group, controls, sizeof(group));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  group = __builtin_bswap64(group);
+#endif
+  return group;
+}
+
+// High bit set in each byte equal to tag. Can also flag a byte just above a
+// real match, which only costs an extra text compare.
+uint64_t matchTag(uint64_t group, uint8_t tag) {
+  uint64_t difference = group ^ (LOW_BITS * tag);
+  return (difference - LOW_BITS) & ~difference & HIGH_BITS;
+}
+
+// Empty slots are the only ones with the high bit set
+uint64_t matchEmpty(uint64_t group) {return group & HIGH_BITS;}
+
+size_t firstSlot(uint64_t matches) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward64(&index, matches);
+  return index / 8;
+#else
+  return __builtin_ctzll(matches) / 8;
+#endif
+}
+
+} // namespace
+
+SymbolId SymbolTable::intern(std::string_view text) {
+  if (controls.empty()) grow();
+
+  size_t hash = hashText(text);
+  size_t slot = findSlot(text, hash);
+  if (controls[slot] != EMPTY) return slots[slot];
+
+  // Keep at least an eighth of the slots empty, so probes stay short
+  if ((texts.size() + 1) * 8 > controls.size() * 7) {
+    grow();
+    slot = findSlot(text, hash);
+  }
+
+  SymbolId id = static_cast<SymbolId>(texts.size());
+  texts.push_back(store(text));
+  controls[slot] = static_cast<uint8_t>(hash & 0x7F);
+  slots[slot] = id;
+  return id;
+}
+
+SymbolId SymbolTable::find(std::string_view text) const {
+  if (controls.empty()) return NO_SYMBOL;
+  size_t slot = findSlot(text, hashText(text));
+  return controls[slot] != EMPTY ? slots[slot] : NO_SYMBOL;
+}
+
+size_t SymbolTable::findSlot(std::string_view text, size_t hash) const {
+  // Groups are probed in triangular steps, which visits every group when the
+  // group count is a power of two
+  size_t groupMask = controls.size() / GROUP_SIZE - 1;
+  size_t group = (hash >> 7) & groupMask;
+  uint8_t tag = static_cast<uint8_t>(hash & 0x7F);
+
+  for (size_t step = 1;; step++) {
+    size_t base = group * GROUP_SIZE;
+    uint64_t controlWord = loadGroup(controls.data() + base);
+
+    for (uint64_t matches = matchTag(controlWord, tag); matches != 0; matches &= matches - 1) {
+      size_t slot = base + firstSlot(matches);
+      if (controls[slot] == tag && texts[slots[slot]] == text) return slot;
+    }
+
+    uint64_t empty = matchEmpty(controlWord);
+    if (empty != 0) return base + firstSlot(empty);
+    group = (group + step) & groupMask;
+  }
+}
+
+void SymbolTable::grow() {
+  size_t capacity = std::max<size_t>(controls.size() * 2, 64);
+  controls.assign(capacity, EMPTY);
+  slots.assign(capacity, NO_SYMBOL);
+
+  // Texts are all unique, so each only needs an empty slot
+  size_t groupMask = capacity / GROUP_SIZE - 1;
+  for (SymbolId id = 0; id < texts.size(); id++) {
+    size_t hash = hashText(texts[id]);
+    size_t group = (hash >> 7) & groupMask;
+    for (size_t step = 1;; step++) {
+      uint64_t empty = matchEmpty(loadGroup(controls.data() + group * GROUP_SIZE));
+      if (empty != 0) {
+        size_t slot = group * GROUP_SIZE + firstSlot(empty);
+        controls[slot] = static_cast<uint8_t>(hash & 0x7F);
+        slots[slot] = id;
+        break;
+      }
+      group = (group + step) & groupMask;
+    }
+  }
+}
+
+std::string_view SymbolTable::store(std::string_view text) {
+  if (text.empty()) return std::string_view();
+
+  if (text.length() > blockRemaining) {
+    // Text bigger than a block gets a block to itself
+    size_t size = std::max(BLOCK_SIZE, text.length());
+    blocks.push_back(std::make_unique<char[]>(size));
+    blockNext = blocks.back().get();
+    blockRemaining = size;
+  }
+
+  char* stored = blockNext;
+  std::memcpy(stored, text.data(), text.length());
+  blockNext += text.length();
+  blockRemaining -= text.length();
+  return std::string_view(stored, text.length());
+}
+
+size_t SharedSymbolTable::shardOf(std::string_view text) {
+  // The top bits, since the shard's own table indexes by the low ones
+  return hashText(text) >> (sizeof(size_t) * 8 - SHARD_BITS);
+}
+
+SymbolId SharedSymbolTable::intern(std::string_view text) {
+  size_t shard = shardOf(text);
+  std::lock_guard<std::mutex> guard(shards[shard].lock);
+  SymbolId local = shards[shard].table.intern(text);
+  if (local >= (NO_SYMBOL >> SHARD_BITS)) throw std::length_error("SharedSymbolTable shard is full");
+  return static_cast<SymbolId>((local << SHARD_BITS) | shard);
+}
+
+SymbolId SharedSymbolTable::find(std::string_view text) const {
+  size_t shard = shardOf(text);
+  std::lock_guard<std::mutex> guard(shards[shard].lock);
+  SymbolId local = shards[shard].table.find(text);
+  return local != NO_SYMBOL ? static_cast<SymbolId>((local << SHARD_BITS) | shard) : NO_SYMBOL;
+}
+
+std::string_view SharedSymbolTable::text(SymbolId id) const {
+  // The text itself never moves, the lock only covers reading its view
+  const Shard& shard = shards[id & (SHARD_COUNT - 1)];
+  std::lock_guard<std::mutex> guard(shard.lock);
+  return shard.table.text(id >> SHARD_BITS);
+}
+
+size_t SharedSymbolTable::size() const {
+  size_t total = 0;
+  for (const Shard& shard : shards) {
+    std::lock_guard<std::mutex> guard(shard.lock);
+    total += shard.table.size();
+  }
+  return total;
+}
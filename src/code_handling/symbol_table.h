@@ -0,0 +1,89 @@
+// symbol_table.h
+
+#ifndef SYMBOL_TABLE_H
+#define SYMBOL_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+using SymbolId = uint32_t;
+inline constexpr SymbolId NO_SYMBOL = UINT32_MAX;
+
+// Interns identifier and literal text as small integer ids, so later stages
+// can compare names as ints and each unique name is stored once. One table can
+// be shared by the lexers of every file in a compilation.
+class SymbolTable {
+public:
+  SymbolTable() = default;
+  SymbolTable(const SymbolTable&) = delete;
+  SymbolTable& operator=(const SymbolTable&) = delete;
+
+  // Id of text, adding it if it hasn't been seen before
+  SymbolId intern(std::string_view text);
+  // Id of text, or NO_SYMBOL if it hasn't been interned
+  SymbolId find(std::string_view text) const;
+  // The interned text, valid for as long as the table is
+  std::string_view text(SymbolId id) const {return texts[id];}
+
+  size_t size() const {return texts.size();}
+
+private:
+  static constexpr size_t BLOCK_SIZE = 16 * 1024;
+
+  // Text is copied into large blocks that never move, which the index and texts view into
+  std::vector<std::unique_ptr<char[]>> blocks;
+  char* blockNext = nullptr;
+  size_t blockRemaining = 0;
+
+  // Open addressing index of ids by text. Each slot has a control byte that's
+  // either EMPTY or the low 7 bits of the text's hash, and a group of 8
+  // control bytes is checked with one word compare, so text is only compared
+  // for slots that probably match. Nothing is ever removed, so there are no
+  // tombstones.
+  static constexpr size_t GROUP_SIZE = 8;
+  static constexpr uint8_t EMPTY = 0x80;
+  std::vector<uint8_t> controls;
+  std::vector<SymbolId> slots;
+  std::vector<std::string_view> texts;
+
+  std::string_view store(std::string_view text);
+  // Slot holding text, or the empty slot it would go in
+  size_t findSlot(std::string_view text, size_t hash) const;
+  void grow();
+};
+
+// A SymbolTable that any number of threads can intern into at once. Texts are
+// split by hash into shards, each a SymbolTable behind its own lock, so
+// threads only wait on each other when they intern into the same shard at the
+// same time. Ids hold the shard in their low bits, so unlike SymbolTable they
+// aren't dense, but they're still equal exactly when the texts are.
+class SharedSymbolTable {
+public:
+  static constexpr size_t SHARD_BITS = 4;
+  static constexpr size_t SHARD_COUNT = size_t(1) << SHARD_BITS;
+
+  SharedSymbolTable() = default;
+  SharedSymbolTable(const SharedSymbolTable&) = delete;
+  SharedSymbolTable& operator=(const SharedSymbolTable&) = delete;
+
+  SymbolId intern(std::string_view text);
+  SymbolId find(std::string_view text) const;
+  std::string_view text(SymbolId id) const;
+
+  size_t size() const;
+
+private:
+  struct Shard {
+    mutable std::mutex lock;
+    SymbolTable table;
+  };
+  Shard shards[SHARD_COUNT];
+
+  static size_t shardOf(std::string_view text);
+};
+
+#endif // SYMBOL_TABLE_H
@@ -0,0 +1,53 @@
+// test_ast.cpp
+
+#include "../code_handling/ast.h"
+#include "../code_handling/lexer.h"
+
+#include <iostream>
+
+void printTree(const Ast& ast, const TokenStream& stream, NodeIndex node, int depth) {
+  std::cout << std::string(depth * 2, ' ') << astKindName(ast[node].kind) << " '" << stream.value(ast[node].token) << "'\n";
+  for (NodeIndex child : ast.children(node)) printTree(ast, stream, child, depth + 1);
+}
+
+// Builds the tree a parser would for "int x = a + 5" by hand
+NodeIndex buildDeclaration(Ast& ast) {
+  NodeList sum;
+  ast.append(sum, ast.add(AstKind::Name, 3));
+  ast.append(sum, ast.add(AstKind::NumberLiteral, 5));
+
+  NodeList declaration;
+  ast.append(declaration, ast.add(AstKind::TypeName, 0));
+  ast.append(declaration, ast.add(AstKind::Binary, 4, sum));
+
+  NodeList statements;
+  ast.append(statements, ast.add(AstKind::VariableDecl, 1, declaration));
+  return ast.add(AstKind::Module, 0, statements);
+}
+
+int main() {
+  Lexer lexer("int x = a + 5");
+  TokenStream stream = lexer.tokenizeAll();
+
+  Ast ast;
+  NodeIndex module = buildDeclaration(ast);
+  std::cout << "Testing a hand built tree:\n";
+  printTree(ast, stream, module, 0);
+  std::cout << ast.size() << " nodes, " << ast.bytesUsed() << " arena bytes used\n";
+
+  std::cout << "\nTesting reset:\n";
+  size_t reserved = ast.arena().bytesReserved();
+  ast.reset();
+  module = buildDeclaration(ast);
+  std::cout << ast.size() << " nodes, arena " << (ast.arena().bytesReserved() == reserved ? "reused" : "grew") << "\n";
+
+  std::cout << "\nTesting move:\n";
+  Ast moved(std::move(ast));
+  std::cout << moved.size() << " nodes moved, " << ast.size() << " left behind\n";
+  // The moved from tree gets memory of its own, so building in it leaves the moved tree alone
+  NodeIndex other = buildDeclaration(ast);
+  ast[ast[other].firstChild].token = 2;
+  printTree(moved, stream, module, 0);
+
+  return 0;
+}
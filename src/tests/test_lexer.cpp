@@ -1,21 +1,280 @@
 // test_lexer.cpp
 
+#include "../code_handling/driver.h"
 #include "../code_handling/lexer.h"
+#include "../code_handling/streaming_lexer.h"
 
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 
 void printTestLexer(const std::string& source) {
   Lexer lexer(source);
   Token token = lexer.nextToken();
 
   while (token.type != TokenType::EndOfFile) {
+    SourcePosition position = lexer.position(token);
     std::cout << "TokenType:" << static_cast<int>(token.type) << ", Value: '"
-              << token.value << "'" << ", Line: " << token.line
-              << ", Column: " << token.column << ")\n";
+              << token.value << "'" << ", Line: " << position.line
+              << ", Column: " << position.column << ")\n";
     token = lexer.nextToken();
   }
 }
 
+void printTestTokenStream(const std::string& source) {
+  Lexer lexer(source);
+  TokenStream stream = lexer.tokenizeAll();
+
+  for (size_t i = 0; stream.kinds[i] != TokenType::EndOfFile; i++) {
+    SourcePosition position = stream.position(i);
+    std::cout << "TokenType:" << static_cast<int>(stream.kinds[i]) << ", Value: '"
+              << stream.value(i) << "'" << ", Line: " << position.line
+              << ", Column: " << position.column << ")\n";
+  }
+}
+
+void printTestRelex(const std::string& source, const TextEdit& edit) {
+  Lexer lexer(source);
+  TokenStream previous = lexer.tokenizeAll();
+
+  std::string edited = source.substr(0, edit.offset) + std::string(edit.inserted) + source.substr(edit.offset + edit.removed);
+  Lexer editedLexer(edited);
+  TokenStream stream = editedLexer.relex(previous, edit);
+
+  for (size_t i = 0; stream.kinds[i] != TokenType::EndOfFile; i++) {
+    SourcePosition position = stream.position(i);
+    std::cout << "TokenType:" << static_cast<int>(stream.kinds[i]) << ", Value: '"
+              << stream.value(i) << "'" << ", Line: " << position.line
+              << ", Column: " << position.column << ")\n";
+  }
+}
+
+// Lexes the edited source from scratch and checks relex gets the same tokens
+// and errors, or throws at the same offset when recovery is off
+void printTestRelexMatches(const std::string& source, const TextEdit& edit, bool recover) {
+  std::string edited = source.substr(0, edit.offset) + std::string(edit.inserted) + source.substr(edit.offset + edit.removed);
+  Lexer lexer(source), editedLexer(edited), freshLexer(edited);
+  if (recover) {
+    lexer.recoverFromErrors();
+    editedLexer.recoverFromErrors();
+    freshLexer.recoverFromErrors();
+  }
+  TokenStream previous = lexer.tokenizeAll();
+
+  TokenStream relexed, fresh;
+  size_t relexError = SIZE_MAX, freshError = SIZE_MAX;
+  try {
+    relexed = editedLexer.relex(previous, edit);
+  } catch (const InvalidTokenError& error) {
+    relexError = error.offset();
+  }
+  try {
+    fresh = freshLexer.tokenizeAll();
+  } catch (const InvalidTokenError& error) {
+    freshError = error.offset();
+  }
+
+  bool sameErrors = relexed.errors.size() == fresh.errors.size();
+  for (size_t i = 0; sameErrors && i < fresh.errors.size(); i++) {
+    sameErrors = relexed.errors[i].offset == fresh.errors[i].offset && relexed.errors[i].error == fresh.errors[i].error;
+  }
+  bool same = relexError == freshError && sameErrors && relexed.kinds == fresh.kinds
+      && relexed.offsets == fresh.offsets && relexed.lengths == fresh.lengths;
+
+  std::cout << (recover ? "Recovering: " : "Throwing: ");
+  if (freshError != SIZE_MAX) std::cout << "error at offset " << freshError << ", ";
+  else std::cout << fresh.size() << " tokens, " << fresh.errors.size() << " errors, ";
+  std::cout << "relex " << (same ? "matches" : "differs from") << " tokenizeAll\n";
+}
+
+void printTestSymbols(const std::string& source) {
+  SymbolTable symbols;
+  Lexer lexer(source);
+  lexer.useSymbolTable(symbols);
+
+  for (Token token = lexer.nextToken(); token.type != TokenType::EndOfFile; token = lexer.nextToken()) {
+    if (token.symbol == NO_SYMBOL) continue;
+    std::cout << "Symbol:" << token.symbol << ", Value: '" << symbols.text(token.symbol) << "'\n";
+  }
+  std::cout << symbols.size() << " unique symbols\n";
+}
+
+void printTestRecovery(const std::string& source) {
+  Lexer lexer(source);
+  lexer.recoverFromErrors();
+
+  TokenStream stream = lexer.tokenizeAll();
+  std::cout << stream.size() << " tokens, " << stream.errors.size() << " errors\n";
+  for (const LexDiagnostic& diagnostic : stream.errors) {
+    std::cout << lexer.formatError(diagnostic) << "\n";
+  }
+}
+
+void printTestStats(const std::string& source) {
+  CompileStats stats;
+  Lexer lexer(source);
+  lexer.useStats(stats);
+  lexer.tokenizeAll();
+
+  std::cout << stats.tokens << " tokens, " << stats.bytesLexed << " bytes lexed, "
+            << stats.runs(CompilePhase::Lex) << " timed lex run\n";
+}
+
+void printTestParallel(const std::string& source) {
+  Lexer serialLexer(source), parallelLexer(source);
+  TokenStream serial = serialLexer.tokenizeAll();
+  TokenStream parallel = parallelLexer.tokenizeParallel(4);
+
+  bool same = serial.kinds == parallel.kinds && serial.offsets == parallel.offsets && serial.lengths == parallel.lengths;
+  std::cout << source.size() << " bytes, " << serial.size() << " tokens, parallel "
+            << (same ? "matches" : "differs from") << " serial\n";
+}
+
+void printTestStreaming(const std::string& source) {
+  for (size_t chunkSize = 1; chunkSize <= 7; chunkSize++) {
+    // Hands out the source a few bytes at a time, so tokens keep hitting the end of the window
+    size_t read = 0;
+    StreamingLexer streaming([&](char* buffer, size_t capacity) {
+      size_t count = std::min({capacity, chunkSize, source.size() - read});
+      std::memcpy(buffer, source.data() + read, count);
+      read += count;
+      return count;
+    }, chunkSize);
+    Lexer lexer(source);
+
+    size_t index = 0, mismatch = 0;
+    bool same = true;
+    for (Token expected = lexer.nextToken();; expected = lexer.nextToken(), index++) {
+      Token token = streaming.nextToken();
+      SourcePosition position = lexer.position(expected);
+      if (token.type != expected.type || token.offset != expected.offset || token.value != expected.value
+          || streaming.position().line != position.line || streaming.position().column != position.column) {
+        same = false;
+        mismatch = index;
+        break;
+      }
+      if (expected.type == TokenType::EndOfFile) break;
+    }
+
+    std::cout << "Chunk size " << chunkSize << ": ";
+    if (same) std::cout << "matches nextToken\n";
+    else std::cout << "differs from nextToken at token " << mismatch << "\n";
+  }
+}
+
+std::string writeTempFile(const std::string& name, const std::string& contents) {
+  std::string path = (std::filesystem::temp_directory_path() / name).string();
+  std::ofstream(path, std::ios::binary) << contents;
+  return path;
+}
+
+bool sameTokens(const TokenStream& a, const TokenStream& b) {
+  return a.kinds == b.kinds && a.offsets == b.offsets && a.lengths == b.lengths;
+}
+
+void printTestSources(const std::string& source) {
+  Lexer expectedLexer(source);
+  TokenStream expected = expectedLexer.tokenizeAll();
+
+  std::string path = writeTempFile("zen_test_source.zen", source);
+  Lexer fileLexer = Lexer::fromFile(path);
+  std::cout << "fromFile (" << (SourceBuffer::fromFile(path).isMapped() ? "mapped" : "read") << ") "
+            << (sameTokens(fileLexer.tokenizeAll(), expected) ? "matches" : "differs from") << " Lexer(std::string)\n";
+
+  std::istringstream stream(source);
+  Lexer streamLexer = Lexer::fromStream(stream);
+  std::cout << "fromStream " << (sameTokens(streamLexer.tokenizeAll(), expected) ? "matches" : "differs from") << " Lexer(std::string)\n";
+
+  // An empty file has nothing to map
+  std::string emptyPath = writeTempFile("zen_test_empty.zen", "");
+  Lexer emptyLexer = Lexer::fromFile(emptyPath);
+  std::cout << "Empty file: " << emptyLexer.tokenizeAll().size() << " token\n";
+
+  try {
+    Lexer::fromFile(std::filesystem::temp_directory_path().string());
+    std::cout << "Directory: lexed as a file\n";
+  } catch (const std::runtime_error&) {
+    std::cout << "Directory: rejected\n";
+  }
+
+  std::filesystem::remove(path);
+  std::filesystem::remove(emptyPath);
+}
+
+// Symbol of the first token in module spelled text, or NO_SYMBOL
+SymbolId symbolOf(const LexedModule& module, std::string_view text) {
+  for (size_t i = 0; i < module.tokens.size(); i++) {
+    if (module.tokens.value(i) == text) return module.tokens.symbols[i];
+  }
+  return NO_SYMBOL;
+}
+
+void printTestModules() {
+  std::vector<std::string> paths = {
+    writeTempFile("zen_test_a.zen", "int count = 0\nfn step(int by) {\n    count += by\n}\n"),
+    writeTempFile("zen_test_b.zen", "step(2)\nprint(count)\n"),
+    (std::filesystem::temp_directory_path() / "zen_test_missing.zen").string(),
+    writeTempFile("zen_test_c.zen", "string label = 'count'\nprint(label, count)\n"),
+  };
+
+  SharedSymbolTable symbols;
+  std::vector<LexedModule> modules = lexModules(paths, symbols, 3);
+  for (const LexedModule& module : modules) {
+    std::cout << std::filesystem::path(module.path).filename().string() << ": ";
+    if (module.error) std::cout << "error set\n";
+    else std::cout << module.tokens.size() << " tokens\n";
+  }
+
+  for (std::string_view name : {"count", "step", "print"}) {
+    // Every module that has the name should have got the same id for it
+    SymbolId id = NO_SYMBOL;
+    bool same = true;
+    for (const LexedModule& module : modules) {
+      SymbolId other = module.error ? NO_SYMBOL : symbolOf(module, name);
+      if (other == NO_SYMBOL) continue;
+      if (id == NO_SYMBOL) id = other;
+      else if (other != id) same = false;
+    }
+    std::cout << "'" << name << "' " << (same ? "has one id" : "has different ids") << " across modules, text "
+              << (symbols.text(id) == name ? "round trips" : "differs") << "\n";
+  }
+
+  for (const std::string& path : paths) std::filesystem::remove(path);
+}
+
+// Offset of the error lexing throws, or SIZE_MAX if there isn't one
+template <typename NextToken>
+size_t errorOffset(NextToken nextToken) {
+  try {
+    while (nextToken().type != TokenType::EndOfFile) {}
+  } catch (const InvalidTokenError& error) {
+    return error.offset();
+  }
+  return SIZE_MAX;
+}
+
+void printTestStreamingError(const std::string& source) {
+  Lexer lexer(source);
+  size_t expected = errorOffset([&] {return lexer.nextToken();});
+
+  for (size_t chunkSize = 1; chunkSize <= 7; chunkSize++) {
+    size_t read = 0;
+    StreamingLexer streaming([&](char* buffer, size_t capacity) {
+      size_t count = std::min({capacity, chunkSize, source.size() - read});
+      std::memcpy(buffer, source.data() + read, count);
+      read += count;
+      return count;
+    }, chunkSize);
+    size_t offset = errorOffset([&] {return streaming.nextToken();});
+
+    std::cout << "Chunk size " << chunkSize << ": error at offset " << offset << ", "
+              << (offset == expected ? "matches" : "differs from") << " nextToken\n";
+  }
+}
+
 int main() {
   std::string sourceCode = R"(
 fn main() {
@@ -31,5 +290,65 @@ fn main() {
   std::cout << "Testing with sample code:\n" << sourceCode << "\n\n";
   printTestLexer(sourceCode);
 
+  std::cout << "\nTesting tokenizeAll with sample code:\n";
+  printTestTokenStream(sourceCode);
+
+  std::cout << "\nTesting relex after changing x > 0 to x > 10:\n";
+  printTestRelex(sourceCode, TextEdit{sourceCode.find("0)"), 1, "10"});
+
+  std::string commented = sourceCode + "/. a doc comment\n . over lines ./\nstring s = \"end\"\n";
+  size_t positive = commented.find("\"Positive");
+  size_t closingQuote = commented.find("\")");
+  // Recovery gives up on the string at the end of its line, so the lines after it were lexed as code
+  std::string unclosed = "int a = 1\nstring s = 'open\nint b = a + 2\nprint(b)\n";
+  struct {
+    const char* description;
+    const std::string& source;
+    TextEdit edit;
+  } relexCases[] = {
+    {"inserting a \" that opens a string", commented, {positive, 0, "\""}},
+    {"deleting the \" that closes a string", commented, {closingQuote, 1, ""}},
+    {"inserting the ' that closes a string lines later", unclosed, {unclosed.find("\nprint"), 0, "'"}},
+    {"inserting a /. that opens a comment", commented, {positive, 0, "/."}},
+    {"deleting the ./ that closes a comment", commented, {commented.find("./"), 2, ""}},
+    {"inserting a ./ that closes a comment early", commented, {commented.find("over"), 0, "./"}},
+  };
+  for (const auto& relexCase : relexCases) {
+    std::cout << "\nTesting relex after " << relexCase.description << ":\n";
+    // An unterminated string can't be lexed without recovery, so there's no previous stream to relex
+    if (&relexCase.source != &unclosed) printTestRelexMatches(relexCase.source, relexCase.edit, false);
+    printTestRelexMatches(relexCase.source, relexCase.edit, true);
+  }
+
+  std::cout << "\nTesting StreamingLexer in small chunks with sample code:\n";
+  printTestStreaming(sourceCode + "/. a doc comment\n . over lines ./\nstring s = 'two\nlines' // end\n");
+
+  std::cout << "\nTesting StreamingLexer error offsets in small chunks:\n";
+  printTestStreamingError(sourceCode + "int y = $5\n");
+
+  std::cout << "\nTesting tokenizeParallel against tokenizeAll:\n";
+  std::string large;
+  for (size_t i = 0; large.size() < 300 * 1024; i++) {
+    large += sourceCode;
+    large += "/. comment " + std::to_string(i) + "\n . 'not a string\n ./\n";
+    large += "string s = \"line one\nline two // not a comment\" + 'x'\n";
+  }
+  printTestParallel(large);
+
+  std::cout << "\nTesting fromFile and fromStream with sample code:\n";
+  printTestSources(sourceCode);
+
+  std::cout << "\nTesting lexModules with a shared symbol table:\n";
+  printTestModules();
+
+  std::cout << "\nTesting symbol interning with sample code:\n";
+  printTestSymbols(sourceCode);
+
+  std::cout << "\nTesting stats with sample code:\n";
+  printTestStats(sourceCode);
+
+  std::cout << "\nTesting error recovery:\n";
+  printTestRecovery("int x = $5\nstring s = 'oops\nx += 1 ` 2\n");
+
   return 0;
 }
\ No newline at end of file